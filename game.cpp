@@ -7,6 +7,13 @@
 #include <limits>      // Для работы с числами
 #include <cstdlib>     // Для системных команд
 #include <ctime>       // Для работы со временем
+#include <cstdint>     // Для целых чисел фиксированного размера
+#include <chrono>      // Для ограничения времени поиска хода
+#include <thread>      // Для параллельного решения уровней
+#include <cstdio>      // Для переименования и удаления файлов
+#include <list>        // Для очереди давно не использованных оценок
+#include <unordered_map> // Для быстрого поиска оценок по позиции
+#include <filesystem>  // Для поиска файлов записей партий
 
 using namespace std;
 
@@ -15,6 +22,40 @@ const char EMPTY_CELL = ' '; // Символ пустой клетки
 const char PLAYER_X = 'X'; // Символ первого игрока
 const char PLAYER_O = 'O'; // Символ второго игрока
 const string SAVE_FILE = "saved_game.txt"; // Имя файла
+const string REPLAY_PREFIX = "replay_"; // Записи партий: replay_<дата>_<время>.replay
+const string REPLAY_EXTENSION = ".replay";
+const int REPLAY_SNAPSHOT_INTERVAL = 4; // Снимок поля в записи через каждые 4 хода
+const int REPLAY_CLASSIC = 0; // Режимы в записи партии: поле 3x3 (клетка = строка * 3 + столбец),
+const int REPLAY_ULTIMATE = 1; // Ultimate (клетка = строка * 9 + столбец, как при вводе хода)
+const int REPLAY_QUBIC = 2; // и Qubic (клетка = слой * 16 + строка * 4 + столбец)
+const string REPLAY_GAME_NAMES[3] = {"classic", "ultimate", "qubic"}; // Названия режимов в файле записи
+const int ANALYSIS_WIN = 100; // Оценка победы в анализе: минус число ходов до нее
+const size_t ANALYSIS_CACHE_SIZE = 1 << 16; // Сколько оценок позиций хранит кэш анализа
+const string DATABASE_FILE = "games.db"; // Файл базы всех партий
+const int CELL_COUNT = BOARD_SIZE * BOARD_SIZE; // Количество клеток поля
+const int POSITION_COUNT = 19683; // Количество раскрасок поля: 3 в степени 9
+const int GAME_CODE_BITS = 19; // Номер перестановки ходов: 9! = 362880 < 2^19
+const uint32_t MOVE_ORDER_COUNT = 362880; // Всего перестановок 9 клеток
+const uint32_t TOTAL_GAMES = 255168; // Всего различных партий 3x3
+const int ULTIMATE_SIZE = 9; // Поле Ultimate: 9 малых полей 3x3
+const int ANY_SUB_BOARD = -1; // Следующий ход разрешен в любое открытое малое поле
+const int ULTIMATE_TIME_LIMIT_MS = 80; // Время на ход компьютера в Ultimate
+const int WIN_SCORE = 1000000; // Оценка выигранной позиции в поиске
+const int QUBIC_SIZE = 4; // Куб 4x4x4
+const int QUBIC_CELLS = 64; // Клеток в кубе: по биту на клетку
+const int QUBIC_TABLE_SIZE = 1 << 20; // Записей в таблице транспозиций (степень двойки)
+const int QUBIC_TIME_LIMIT_MS = 1500; // Время на ход компьютера в Qubic
+const string QUBIC_SAVE_FILE = "saved_qubic.txt"; // Файл сохранения Qubic
+const string OPENING_BOOK_FILE = "qubic_book.bin"; // Дебютная книга Qubic
+const int BOOK_PLIES = 10; // Сколько первых ходов партии попадает в книгу
+const uint32_t BOOK_MIN_GAMES = 2; // Ход из книги играется, если его сыграли хотя бы столько раз
+const int BOOK_TIME_LIMIT_MS = 50; // Время на ход в партиях самоигры для книги
+const int SOLVER_MAX_CELLS = 16; // Решатель работает с полями до 4x4
+const int SOLVER_CHUNK_BYTES = 1 << 16; // Размер блока при записи уровня на диск
+const int SOLVED_UNKNOWN = 0; // 2-битные значения позиций для игрока, который ходит
+const int SOLVED_LOSS = 1;
+const int SOLVED_DRAW = 2;
+const int SOLVED_WIN = 3;
 
 typedef vector<vector<char> > GameBoard;
 
@@ -167,23 +208,35 @@ string getChoice(const string& prompt) {
 }
 
 // Создание пустого игрового поля
-GameBoard createEmptyBoard() {
-    // Создаем двумерный вектор: BOARD_SIZE строк, каждая строка - вектор из BOARD_SIZE пробелов
-    return GameBoard(BOARD_SIZE, vector<char>(BOARD_SIZE, EMPTY_CELL));
+GameBoard createEmptyBoard(int size = BOARD_SIZE) {
+    // Создаем двумерный вектор: size строк, каждая строка - вектор из size пробелов
+    return GameBoard(size, vector<char>(size, EMPTY_CELL));
 }
 
 // Красивый вывод игрового поля на экран
-void displayBoard(const GameBoard& board) {
+// (analysis - оценки пустых клеток: W/D/L цветом победы, ничьей или поражения)
+void displayBoard(const GameBoard& board, const vector<vector<int> >* analysis = NULL) {
+    int size = board.size();
+    // Линия границы: по "+---" на каждый столбец
+    string border = "  +";
+    for (int col = 0; col < size; col++) {
+        border += "---+";
+    }
+    
+    cout << "\n";
+    cout << "  ";
+    for (int col = 0; col < size; col++) {
+        cout << "  " << (col + 1) << " ";  // Номера столбцов
+    }
     cout << "\n";
-    cout << "    1   2   3\n";  // Номера столбцов
     
-    cout << "  +---+---+---+\n";  // Верхняя граница
+    cout << border << "\n";  // Верхняя граница
     
-    for (int row = 0; row < BOARD_SIZE; row++) {
+    for (int row = 0; row < size; row++) {
         // Буква строки: A, B, C (соответствует индексам 0, 1, 2)
         cout << char('A' + row) << " | ";
         
-        for (int col = 0; col < BOARD_SIZE; col++) {
+        for (int col = 0; col < size; col++) {
             char cell = board[row][col];
             
             // Выводим символ с цветом в зависимости от игрока
@@ -191,6 +244,11 @@ void displayBoard(const GameBoard& board) {
                 printColor(string(1, cell), 31);  // Красный для X
             } else if (cell == PLAYER_O) {
                 printColor(string(1, cell), 34);  // Синий для O
+            } else if (analysis != NULL) {
+                int value = (*analysis)[row][col];
+                if (value > 0) printColor("W", 32);       // Зеленый - победа
+                else if (value < 0) printColor("L", 31);  // Красный - поражение
+                else printColor("D", 33);                 // Желтый - ничья
             } else {
                 cout << cell;  // Пустая клетка - пробел
             }
@@ -200,177 +258,2765 @@ void displayBoard(const GameBoard& board) {
         
         cout << "\n";
         
-        if (row < BOARD_SIZE - 1) {
-            cout << "  +---+---+---+\n";  // Разделитель между строками
+        if (row < size - 1) {
+            cout << border << "\n";  // Разделитель между строками
+        }
+    }
+    
+    cout << border << "\n\n";  // Нижняя граница
+}
+
+// Проверка, правильный ли формат хода
+// (size - размер поля, для больших режимов до 9x9: буквы A-I, цифры 1-9)
+bool isValidMove(const string& input, int& row, int& col, int size = BOARD_SIZE) {
+    // Ход должен состоять из 2 символов: буква + цифра
+    if (input.length() != 2) return false;
+    
+    // Первый символ - буква строки (A, B, C)
+    char rowChar = toupper(input[0]);
+    // Второй символ - цифра столбца (1, 2, 3)
+    char colChar = input[1];
+    
+    // Проверяем допустимость буквы строки
+    if (rowChar < 'A' || rowChar > 'A' + size - 1) return false;
+    // Проверяем допустимость цифры столбца
+    if (colChar < '1' || colChar > '0' + size) return false;
+    
+    // Преобразуем символы в индексы массива:
+    // 'A' -> 0, 'B' -> 1, 'C' -> 2
+    // '1' -> 0, '2' -> 1, '3' -> 2
+    row = rowChar - 'A';
+    col = colChar - '1';
+    
+    return true;
+}
+
+// Проверка хода Qubic: цифра слоя и ход в формате isValidMove (например, 2B3)
+bool isValidQubicMove(const string& input, int& cell) {
+    if (input.length() != 3) return false;
+    
+    char layerChar = input[0];
+    if (layerChar < '1' || layerChar > '0' + QUBIC_SIZE) return false;
+    
+    int row, col;
+    if (!isValidMove(input.substr(1), row, col, QUBIC_SIZE)) return false;
+    
+    cell = (layerChar - '1') * QUBIC_SIZE * QUBIC_SIZE + row * QUBIC_SIZE + col;
+    return true;
+}
+
+// Сделать ход на поле
+bool makeMove(GameBoard& board, int row, int col, char player) {
+    // Проверяем, что координаты в пределах поля
+    int size = board.size();
+    if (row < 0 || row >= size || 
+        col < 0 || col >= size) {
+        return false;
+    }
+    
+    // Проверяем, что клетка пуста
+    if (board[row][col] != EMPTY_CELL) {
+        return false;
+    }
+    
+    // Ставим символ игрока в указанную клетку
+    board[row][col] = player;
+    return true;
+}
+
+// Направления линий: по строке, по столбцу, главная и побочная диагонали
+const int LINE_ROW_STEP[4] = {0, 1, 1, 1};
+const int LINE_COL_STEP[4] = {1, 0, 1, -1};
+
+// Проверка, есть ли победитель
+// (winLength - сколько одинаковых символов подряд нужно; по умолчанию вся сторона поля 3x3)
+char checkWinner(const GameBoard& board, int winLength = BOARD_SIZE) {
+    int size = board.size();
+    
+    for (int row = 0; row < size; row++) {
+        for (int col = 0; col < size; col++) {
+            char first = board[row][col];
+            if (first == EMPTY_CELL) continue;
+            
+            // Пробуем собрать winLength одинаковых символов, начиная с этой клетки
+            for (int dir = 0; dir < 4; dir++) {
+                int endRow = row + LINE_ROW_STEP[dir] * (winLength - 1);
+                int endCol = col + LINE_COL_STEP[dir] * (winLength - 1);
+                if (endRow < 0 || endRow >= size || endCol < 0 || endCol >= size) continue;
+                
+                bool sameSymbols = true;
+                for (int step = 1; step < winLength; step++) {
+                    if (board[row + LINE_ROW_STEP[dir] * step][col + LINE_COL_STEP[dir] * step] != first) {
+                        sameSymbols = false;
+                        break;
+                    }
+                }
+                if (sameSymbols) {
+                    return first;  // Возвращаем символ победителя
+                }
+            }
+        }
+    }
+    
+    // Если ни одна линия не собрана - победителя нет
+    return EMPTY_CELL;
+}
+
+// Все выигрышные линии поля size x size длиной winLength (бит клетки = строка * size + столбец)
+vector<uint32_t> buildLineMasks(int size, int winLength) {
+    vector<uint32_t> lines;
+    
+    for (int row = 0; row < size; row++) {
+        for (int col = 0; col < size; col++) {
+            for (int dir = 0; dir < 4; dir++) {
+                int endRow = row + LINE_ROW_STEP[dir] * (winLength - 1);
+                int endCol = col + LINE_COL_STEP[dir] * (winLength - 1);
+                if (endRow < 0 || endRow >= size || endCol < 0 || endCol >= size) continue;
+                
+                uint32_t mask = 0;
+                for (int step = 0; step < winLength; step++) {
+                    mask |= 1u << ((row + LINE_ROW_STEP[dir] * step) * size + col + LINE_COL_STEP[dir] * step);
+                }
+                lines.push_back(mask);
+            }
+        }
+    }
+    return lines;
+}
+
+// Есть ли среди клеток маски хотя бы одна собранная линия
+bool maskHasLine(uint32_t mask, const vector<uint32_t>& lines) {
+    for (size_t i = 0; i < lines.size(); i++) {
+        if ((mask & lines[i]) == lines[i]) return true;
+    }
+    return false;
+}
+
+// Проверка, заполнено ли всё поле (ничья)
+bool isDraw(const GameBoard& board) {
+    // Проходим по всем клеткам поля
+    for (size_t i = 0; i < board.size(); i++) {
+        for (size_t j = 0; j < board[i].size(); j++) {
+            // Если найдена хоть одна пустая клетка - это не ничья
+            if (board[i][j] == EMPTY_CELL) {
+                return false;
+            }
+        }
+    }
+    // Если все клетки заполнены - ничья
+    return true;
+}
+
+// Сохранить игру в файл
+bool saveGame(const GameBoard& board, char currentPlayer) {
+    // Открываем файл для записи
+    ofstream file(SAVE_FILE);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: не могу создать файл для сохранения!\n", 31);
+        return false;
+    }
+    
+    // Сохраняем текущего игрока (чей ход)
+    file << currentPlayer << endl;
+    
+    // Сохраняем игровое поле: каждая строка поля - отдельная строка в файле
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            file << board[i][j];  // Записываем символ клетки
+        }
+        file << endl;  // Переход на новую строку после каждой строки поля
+    }
+    
+    file.close();
+    return true;
+}
+
+// Загрузить игру из файла
+bool loadGame(GameBoard& board, char& currentPlayer) {
+    // Открываем файл для чтения
+    ifstream file(SAVE_FILE);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: файл сохранения не найден!\n", 31);
+        return false;
+    }
+    
+    string line;
+    // Читаем первую строку - символ текущего игрока
+    if (!getline(file, line) || line.empty()) {
+        printColor("Ошибка: файл поврежден!\n", 31);
+        return false;
+    }
+    currentPlayer = line[0];
+    
+    int rowNum = 0;
+    // Читаем следующие 3 строки - игровое поле
+    while (getline(file, line) && rowNum < BOARD_SIZE) {
+        // Проверяем, что строка имеет правильную длину
+        if (line.length() != BOARD_SIZE) {
+            printColor("Ошибка: неправильный формат поля в файле!\n", 31);
+            return false;
+        }
+        
+        // Копируем символы из строки в игровое поле
+        for (int col = 0; col < BOARD_SIZE; col++) {
+            board[rowNum][col] = line[col];
+        }
+        rowNum++;
+    }
+    
+    file.close();
+    
+    // Проверяем, что загружено полное поле (3 строки)
+    if (rowNum != BOARD_SIZE) {
+        printColor("Ошибка: неполное поле в файле!\n", 31);
+        return false;
+    }
+    
+    return true;
+}
+
+// Кэш оценок позиций с вытеснением давно не использованных (LRU), общий для всех партий
+struct AnalysisCache {
+    list<pair<uint64_t, int> > recent;  // Позиции и оценки, недавно использованные - в начале
+    unordered_map<uint64_t, list<pair<uint64_t, int> >::iterator> index;  // Позиция -> место в списке
+    size_t capacity;                    // Сколько позиций хранить
+    long hits;                          // Сколько раз оценка нашлась в кэше
+    long lookups;                       // Сколько раз оценку искали
+};
+
+// Единственный кэш оценок программы
+AnalysisCache& analysisCache() {
+    static AnalysisCache cache = {list<pair<uint64_t, int> >(),
+                                  unordered_map<uint64_t, list<pair<uint64_t, int> >::iterator>(),
+                                  ANALYSIS_CACHE_SIZE, 0, 0};
+    return cache;
+}
+
+// Найти оценку в кэше; найденная позиция становится самой свежей
+bool findCachedValue(AnalysisCache& cache, uint64_t key, int& value) {
+    cache.lookups++;
+    unordered_map<uint64_t, list<pair<uint64_t, int> >::iterator>::iterator it = cache.index.find(key);
+    if (it == cache.index.end()) return false;
+    
+    cache.hits++;
+    cache.recent.splice(cache.recent.begin(), cache.recent, it->second);
+    value = it->second->second;
+    return true;
+}
+
+// Запомнить оценку; при переполнении вытесняется самая старая позиция
+void storeCachedValue(AnalysisCache& cache, uint64_t key, int value) {
+    cache.recent.push_front(make_pair(key, value));
+    cache.index[key] = cache.recent.begin();
+    if (cache.recent.size() > cache.capacity) {
+        cache.index.erase(cache.recent.back().first);
+        cache.recent.pop_back();
+    }
+}
+
+// Ключ позиции для кэша: клетки в троичной системе и игрок, который ходит
+uint64_t analysisKey(const GameBoard& board, char player) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < board.size(); i++) {
+        for (size_t j = 0; j < board[i].size(); j++) {
+            int digit = (board[i][j] == PLAYER_X) ? 1 : ((board[i][j] == PLAYER_O) ? 2 : 0);
+            key = key * 3 + digit;
+        }
+    }
+    return key * 2 + ((player == PLAYER_O) ? 1 : 0);
+}
+
+// Оценка хода в клетку для игрока, который ходит:
+// ANALYSIS_WIN - n - победа через n ходов, -(ANALYSIS_WIN - n) - поражение, 0 - ничья
+int evaluateCellMove(GameBoard& board, int row, int col, char player);
+
+// Точная оценка позиции для игрока, который ходит (лучший из его ходов)
+int solvePosition(GameBoard& board, char player) {
+    AnalysisCache& cache = analysisCache();
+    uint64_t key = analysisKey(board, player);
+    int best;
+    if (findCachedValue(cache, key, best)) return best;
+    
+    best = -ANALYSIS_WIN;
+    for (size_t i = 0; i < board.size(); i++) {
+        for (size_t j = 0; j < board[i].size(); j++) {
+            if (board[i][j] != EMPTY_CELL) continue;
+            best = max(best, evaluateCellMove(board, i, j, player));
+        }
+    }
+    
+    storeCachedValue(cache, key, best);
+    return best;
+}
+
+int evaluateCellMove(GameBoard& board, int row, int col, char player) {
+    board[row][col] = player;
+    int value;
+    if (checkWinner(board) == player) {
+        value = ANALYSIS_WIN - 1;  // Победа этим же ходом
+    } else if (isDraw(board)) {
+        value = 0;
+    } else {
+        // Оценка соперника с обратным знаком, до конца партии на один ход больше
+        int reply = solvePosition(board, (player == PLAYER_X) ? PLAYER_O : PLAYER_X);
+        if (reply > 0) value = -reply + 1;
+        else if (reply < 0) value = -reply - 1;
+        else value = 0;
+    }
+    board[row][col] = EMPTY_CELL;
+    return value;
+}
+
+// Показать поле с оценкой каждой пустой клетки и статистику кэша
+void showAnalysis(const GameBoard& board, char player) {
+    GameBoard work = board;
+    AnalysisCache& cache = analysisCache();
+    long hitsBefore = cache.hits;
+    long lookupsBefore = cache.lookups;
+    
+    int size = board.size();
+    vector<vector<int> > values(size, vector<int>(size, 0));
+    for (int row = 0; row < size; row++) {
+        for (int col = 0; col < size; col++) {
+            if (board[row][col] == EMPTY_CELL) {
+                values[row][col] = evaluateCellMove(work, row, col, player);
+            }
+        }
+    }
+    
+    printHeader();
+    printColor("----АНАЛИЗ ПОЗИЦИИ----\n", 33);
+    cout << "\nХодит игрок " << player << ". Оценка каждой свободной клетки:";
+    displayBoard(board, &values);
+    
+    for (int row = 0; row < size; row++) {
+        for (int col = 0; col < size; col++) {
+            if (board[row][col] != EMPTY_CELL) continue;
+            
+            int value = values[row][col];
+            cout << "  " << char('A' + row) << (col + 1) << ": ";
+            if (value > 0) {
+                printColor("победа, ходов до конца: " + to_string(ANALYSIS_WIN - value) + "\n", 32);
+            } else if (value < 0) {
+                printColor("поражение, ходов до конца: " + to_string(ANALYSIS_WIN + value) + "\n", 31);
+            } else {
+                printColor("ничья\n", 33);
+            }
+        }
+    }
+    
+    long hits = cache.hits - hitsBefore;
+    long lookups = cache.lookups - lookupsBefore;
+    cout << "\nКэш оценок: " << cache.recent.size() << " из " << cache.capacity << " позиций\n";
+    cout << "Попаданий в этом анализе: " << hits << " из " << lookups;
+    if (lookups > 0) cout << " (" << hits * 100 / lookups << "%)";
+    cout << "\nВсего попаданий: " << cache.hits << " из " << cache.lookups;
+    if (cache.lookups > 0) cout << " (" << cache.hits * 100 / cache.lookups << "%)";
+    cout << "\n";
+}
+
+// База всех партий 3x3 с индексами для быстрых запросов
+struct GameDatabase {
+    vector<uint32_t> codes;            // Номер перестановки ходов для каждой партии
+    vector<unsigned char> lengths;     // Длина каждой партии в ходах
+    vector<char> winners;              // Победитель партии (пробел - ничья)
+    vector<uint32_t> positionStart;    // Начало списка партий для каждой позиции
+    vector<uint32_t> positionGames;    // Номера партий, сгруппированные по позициям
+    vector<uint32_t> resultStart;      // Начало списка партий для пары (исход, длина)
+    vector<uint32_t> resultGames;      // Номера партий, сгруппированные по исходу и длине
+    int openingCount[CELL_COUNT];      // Количество партий для каждого первого хода
+};
+
+// Номер исхода партии для индекса: 0 - победа X, 1 - победа O, 2 - ничья
+int resultIndex(char winner) {
+    if (winner == PLAYER_X) return 0;
+    if (winner == PLAYER_O) return 1;
+    return 2;
+}
+
+// Ключ позиции: число в троичной системе, где 1 - клетка первого игрока, 2 - второго
+int positionKey(const GameBoard& board, char firstPlayer) {
+    int key = 0;
+    for (int i = BOARD_SIZE - 1; i >= 0; i--) {
+        for (int j = BOARD_SIZE - 1; j >= 0; j--) {
+            int digit = 0;
+            if (board[i][j] == firstPlayer) {
+                digit = 1;
+            } else if (board[i][j] != EMPTY_CELL) {
+                digit = 2;
+            }
+            key = key * 3 + digit;
+        }
+    }
+    return key;
+}
+
+// Определить, кто ходил первым, по количеству символов и текущему игроку
+char detectFirstPlayer(const GameBoard& board, char currentPlayer) {
+    int countX = 0;
+    int countO = 0;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            if (board[i][j] == PLAYER_X) countX++;
+            if (board[i][j] == PLAYER_O) countO++;
+        }
+    }
+    // У первого игрока символов больше, при равенстве ходит именно он
+    if (countX > countO) return PLAYER_X;
+    if (countO > countX) return PLAYER_O;
+    return currentPlayer;
+}
+
+// Закодировать порядок ходов номером перестановки (код Лемера).
+// Недоигранные клетки дописываются в конец по возрастанию,
+// поэтому длина партии восстанавливается повторным проигрыванием.
+uint32_t encodeMoveOrder(const vector<int>& moves) {
+    vector<bool> used(CELL_COUNT, false);
+    vector<int> order = moves;
+    for (size_t i = 0; i < moves.size(); i++) {
+        used[moves[i]] = true;
+    }
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        if (!used[cell]) order.push_back(cell);
+    }
+    
+    uint32_t code = 0;
+    for (int i = 0; i < CELL_COUNT; i++) {
+        // Считаем, сколько еще не использованных клеток меньше текущей
+        int smaller = 0;
+        for (int j = i + 1; j < CELL_COUNT; j++) {
+            if (order[j] < order[i]) smaller++;
+        }
+        code = code * (CELL_COUNT - i) + smaller;
+    }
+    return code;
+}
+
+// Восстановить полную перестановку клеток по ее номеру
+vector<int> decodeMoveOrder(uint32_t code) {
+    vector<int> digits(CELL_COUNT);
+    for (int i = CELL_COUNT - 1; i >= 0; i--) {
+        digits[i] = code % (CELL_COUNT - i);
+        code /= (CELL_COUNT - i);
+    }
+    
+    vector<int> freeCells;
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        freeCells.push_back(cell);
+    }
+    
+    vector<int> order;
+    for (int i = 0; i < CELL_COUNT; i++) {
+        order.push_back(freeCells[digits[i]]);
+        freeCells.erase(freeCells.begin() + digits[i]);
+    }
+    return order;
+}
+
+// Проиграть партию по ее коду: возвращает длину, заполняет победителя
+// и (если нужно) ключи всех позиций, через которые прошла партия
+int replayGameCode(uint32_t code, char& winner, vector<int>* keys) {
+    vector<int> order = decodeMoveOrder(code);
+    GameBoard board = createEmptyBoard();
+    char player = PLAYER_X;
+    winner = EMPTY_CELL;
+    
+    if (keys != NULL) {
+        keys->clear();
+        keys->push_back(0);  // Все партии начинаются с пустого поля
+    }
+    
+    for (int i = 0; i < CELL_COUNT; i++) {
+        makeMove(board, order[i] / BOARD_SIZE, order[i] % BOARD_SIZE, player);
+        if (keys != NULL) keys->push_back(positionKey(board, PLAYER_X));
+        
+        winner = checkWinner(board);
+        if (winner != EMPTY_CELL || isDraw(board)) {
+            return i + 1;
+        }
+        player = (player == PLAYER_X) ? PLAYER_O : PLAYER_X;
+    }
+    return CELL_COUNT;
+}
+
+// Перебор всех возможных партий (X ходит первым), партия заканчивается победой или ничьей
+void enumerateGames(GameBoard& board, vector<int>& moves, char player, vector<uint32_t>& codes) {
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        int row = cell / BOARD_SIZE;
+        int col = cell % BOARD_SIZE;
+        if (!makeMove(board, row, col, player)) continue;
+        moves.push_back(cell);
+        
+        if (checkWinner(board) != EMPTY_CELL || isDraw(board)) {
+            codes.push_back(encodeMoveOrder(moves));
+        } else {
+            enumerateGames(board, moves, (player == PLAYER_X) ? PLAYER_O : PLAYER_X, codes);
+        }
+        
+        moves.pop_back();
+        board[row][col] = EMPTY_CELL;
+    }
+}
+
+// Сохранить коды партий в файл, упаковав каждый в GAME_CODE_BITS бит
+bool saveDatabase(const vector<uint32_t>& codes) {
+    ofstream file(DATABASE_FILE, ios::binary);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: не могу создать файл базы партий!\n", 31);
+        return false;
+    }
+    
+    vector<unsigned char> packed((codes.size() * GAME_CODE_BITS + 7) / 8, 0);
+    size_t bit = 0;
+    for (size_t i = 0; i < codes.size(); i++) {
+        for (int b = 0; b < GAME_CODE_BITS; b++, bit++) {
+            if (codes[i] & (1u << b)) {
+                packed[bit / 8] |= static_cast<unsigned char>(1 << (bit % 8));
+            }
+        }
+    }
+    
+    uint32_t count = static_cast<uint32_t>(codes.size());
+    file.write("TTTDB1", 6);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+    
+    file.close();
+    return true;
+}
+
+// Загрузить коды партий из файла базы
+bool loadDatabase(vector<uint32_t>& codes) {
+    ifstream file(DATABASE_FILE, ios::binary);
+    
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    char magic[6];
+    uint32_t count = 0;
+    if (!file.read(magic, 6) || string(magic, 6) != "TTTDB1" ||
+        !file.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+        printColor("Ошибка: файл базы партий поврежден!\n", 31);
+        return false;
+    }
+    
+    // Набор партий фиксирован: и количество, и размер файла известны заранее
+    size_t packedSize = (static_cast<size_t>(TOTAL_GAMES) * GAME_CODE_BITS + 7) / 8;
+    file.seekg(0, ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(6 + sizeof(count), ios::beg);
+    if (count != TOTAL_GAMES || fileSize != 6 + sizeof(count) + packedSize) {
+        printColor("Ошибка: файл базы партий поврежден!\n", 31);
+        return false;
+    }
+    
+    // Весь файл читается одним блоком, без разбора по строкам
+    vector<unsigned char> packed(packedSize);
+    if (!file.read(reinterpret_cast<char*>(packed.data()), packed.size())) {
+        printColor("Ошибка: файл базы партий поврежден!\n", 31);
+        return false;
+    }
+    
+    codes.assign(count, 0);
+    size_t bit = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        for (int b = 0; b < GAME_CODE_BITS; b++, bit++) {
+            if (packed[bit / 8] & (1 << (bit % 8))) {
+                codes[i] |= (1u << b);
+            }
+        }
+        // Номер вне диапазона перестановок не восстановится в партию
+        if (codes[i] >= MOVE_ORDER_COUNT) {
+            printColor("Ошибка: файл базы партий поврежден!\n", 31);
+            codes.clear();
+            return false;
+        }
+    }
+    
+    file.close();
+    return true;
+}
+
+// Построить индексы: по позициям, по исходу и длине, по первому ходу
+void buildDatabaseIndexes(GameDatabase& db) {
+    size_t gameCount = db.codes.size();
+    int resultSlots = 3 * (CELL_COUNT + 1);
+    
+    db.lengths.assign(gameCount, 0);
+    db.winners.assign(gameCount, EMPTY_CELL);
+    db.positionStart.assign(POSITION_COUNT + 1, 0);
+    db.resultStart.assign(resultSlots + 1, 0);
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        db.openingCount[cell] = 0;
+    }
+    
+    // Первый проход: длины и исходы партий, размеры всех списков
+    vector<int> keys;
+    for (size_t g = 0; g < gameCount; g++) {
+        char winner;
+        int length = replayGameCode(db.codes[g], winner, &keys);
+        db.lengths[g] = static_cast<unsigned char>(length);
+        db.winners[g] = winner;
+        
+        for (size_t k = 0; k < keys.size(); k++) {
+            db.positionStart[keys[k] + 1]++;
+        }
+        db.resultStart[resultIndex(winner) * (CELL_COUNT + 1) + length + 1]++;
+        db.openingCount[decodeMoveOrder(db.codes[g])[0]]++;
+    }
+    
+    // Превращаем размеры в смещения начала каждого списка
+    for (int k = 0; k < POSITION_COUNT; k++) {
+        db.positionStart[k + 1] += db.positionStart[k];
+    }
+    for (int r = 0; r < resultSlots; r++) {
+        db.resultStart[r + 1] += db.resultStart[r];
+    }
+    
+    // Второй проход: раскладываем номера партий по спискам
+    db.positionGames.assign(db.positionStart[POSITION_COUNT], 0);
+    db.resultGames.assign(gameCount, 0);
+    vector<uint32_t> positionFill(db.positionStart.begin(), db.positionStart.end() - 1);
+    vector<uint32_t> resultFill(db.resultStart.begin(), db.resultStart.end() - 1);
+    for (size_t g = 0; g < gameCount; g++) {
+        char winner;
+        replayGameCode(db.codes[g], winner, &keys);
+        for (size_t k = 0; k < keys.size(); k++) {
+            db.positionGames[positionFill[keys[k]]++] = static_cast<uint32_t>(g);
+        }
+        db.resultGames[resultFill[resultIndex(winner) * (CELL_COUNT + 1) + db.lengths[g]]++] =
+            static_cast<uint32_t>(g);
+    }
+}
+
+// Открыть базу партий: загрузить из файла или сгенерировать заново
+bool openGameDatabase(GameDatabase& db) {
+    // Отсутствующий или поврежденный файл создается заново
+    if (!loadDatabase(db.codes)) {
+        cout << "Генерация базы всех партий...\n";
+        db.codes.clear();
+        GameBoard board = createEmptyBoard();
+        vector<int> moves;
+        enumerateGames(board, moves, PLAYER_X, db.codes);
+        
+        if (!saveDatabase(db.codes)) {
+            return false;
+        }
+    }
+    
+    buildDatabaseIndexes(db);
+    return true;
+}
+
+// Количество партий, проходящих через позицию
+int countGamesThrough(const GameDatabase& db, const GameBoard& board, char firstPlayer) {
+    int key = positionKey(board, firstPlayer);
+    return db.positionStart[key + 1] - db.positionStart[key];
+}
+
+// Количество партий, где игрок побеждает ровно за указанное число ходов
+// (в базе первым ходит X; EMPTY_CELL означает ничью)
+int countGamesWithResult(const GameDatabase& db, char winner, int moves) {
+    if (moves < 0 || moves > CELL_COUNT) return 0;
+    int slot = resultIndex(winner) * (CELL_COUNT + 1) + moves;
+    return db.resultStart[slot + 1] - db.resultStart[slot];
+}
+
+// Показать статистику базы партий
+void showGameDatabase() {
+    printHeader();
+    printColor("----БАЗА ПАРТИЙ----\n", 33);
+    cout << "\n";
+    
+    GameDatabase db;
+    if (!openGameDatabase(db)) {
+        waitForEnter();
+        return;
+    }
+    
+    cout << "Всего партий: " << db.codes.size() << "\n";
+    cout << "Размер файла: " << (db.codes.size() * GAME_CODE_BITS + 7) / 8
+         << " байт (" << GAME_CODE_BITS << " бит на партию)\n";
+    
+    cout << "\nПартии по первому ходу (первым ходит X):\n";
+    for (int cell = 0; cell < CELL_COUNT; cell++) {
+        cout << "  " << char('A' + cell / BOARD_SIZE) << (cell % BOARD_SIZE + 1)
+             << ": " << db.openingCount[cell] << "\n";
+    }
+    
+    cout << "\nИсходы по числу ходов:\n";
+    cout << "  ходов   победа X   победа O     ничья\n";
+    for (int moves = 1; moves <= CELL_COUNT; moves++) {
+        int winsX = countGamesWithResult(db, PLAYER_X, moves);
+        int winsO = countGamesWithResult(db, PLAYER_O, moves);
+        int draws = countGamesWithResult(db, EMPTY_CELL, moves);
+        if (winsX + winsO + draws == 0) continue;
+        
+        cout << "  " << moves << "\t  " << winsX << "\t     " << winsO << "\t  " << draws << "\n";
+    }
+    
+    // Сохраненная игра служит ключом запроса по позиции
+    GameBoard board = createEmptyBoard();
+    char currentPlayer = PLAYER_X;
+    ifstream saved(SAVE_FILE);
+    if (saved.is_open()) {
+        saved.close();
+        if (loadGame(board, currentPlayer)) {
+            char firstPlayer = detectFirstPlayer(board, currentPlayer);
+            int key = positionKey(board, firstPlayer);
+            
+            int results[3] = {0, 0, 0};
+            for (uint32_t i = db.positionStart[key]; i < db.positionStart[key + 1]; i++) {
+                results[resultIndex(db.winners[db.positionGames[i]])]++;
+            }
+            
+            cout << "\nСохраненная позиция:";
+            displayBoard(board);
+            cout << "Через нее проходит партий: " << countGamesThrough(db, board, firstPlayer) << "\n";
+            // В базе первым ходит X, поэтому исходы пересчитываем на реальных игроков
+            char secondPlayer = (firstPlayer == PLAYER_X) ? PLAYER_O : PLAYER_X;
+            cout << "  победа " << firstPlayer << ": " << results[0] << "\n";
+            cout << "  победа " << secondPlayer << ": " << results[1] << "\n";
+            cout << "  ничья: " << results[2] << "\n";
+        }
+    }
+    
+    waitForEnter();
+}
+
+// Запись партии: список ходов и снимки поля через каждые interval ходов.
+// Поле хранится строкой символов клеток, поэтому формат общий для всех режимов
+struct Replay {
+    int game;                  // Режим: REPLAY_CLASSIC, REPLAY_ULTIMATE или REPLAY_QUBIC
+    int size;                  // Сторона поля (в Qubic - сторона куба)
+    int cellCount;             // Количество клеток
+    int interval;              // Через сколько ходов делается снимок поля
+    char firstPlayer;          // Кто ходил первым
+    vector<int> moves;         // Номера клеток ходов
+    vector<string> snapshots;  // Поле после 0, interval, 2 * interval... ходов
+    string position;           // Поле после последнего хода записи
+};
+
+// Клетки поля строкой: строка * size + столбец
+string boardCells(const GameBoard& board) {
+    string cells;
+    for (size_t row = 0; row < board.size(); row++) {
+        cells += string(board[row].begin(), board[row].end());
+    }
+    return cells;
+}
+
+// Поле size x size из строки клеток
+GameBoard cellsToBoard(const string& cells, int size) {
+    GameBoard board = createEmptyBoard(size);
+    for (int cell = 0; cell < size * size; cell++) {
+        board[cell / size][cell % size] = cells[cell];
+    }
+    return board;
+}
+
+// Количество клеток в записи: в Qubic поле - куб, в остальных режимах - квадрат
+int replayCellCount(int game, int size) {
+    return (game == REPLAY_QUBIC) ? size * size * size : size * size;
+}
+
+// Упаковать поле: 2 бита на клетку, записанные шестнадцатеричными цифрами
+string packCells(const string& cells) {
+    const char digits[] = "0123456789abcdef";
+    string packed;
+    int value = 0;
+    int bits = 0;
+    for (size_t cell = 0; cell < cells.length(); cell++) {
+        char symbol = cells[cell];
+        value |= ((symbol == PLAYER_X) ? 1 : ((symbol == PLAYER_O) ? 2 : 0)) << bits;
+        bits += 2;
+        if (bits == 4) {
+            packed += digits[value];
+            value = 0;
+            bits = 0;
+        }
+    }
+    if (bits > 0) packed += digits[value];
+    return packed;
+}
+
+// Распаковать поле из строки; false, если строка не подходит по размеру или символам
+bool unpackCells(const string& packed, int cellCount, string& cells) {
+    if (packed.length() != static_cast<size_t>((cellCount + 1) / 2)) return false;
+    
+    cells.assign(cellCount, EMPTY_CELL);
+    for (int cell = 0; cell < cellCount; cell++) {
+        char digit = packed[cell / 2];
+        int value;
+        if (digit >= '0' && digit <= '9') value = digit - '0';
+        else if (digit >= 'a' && digit <= 'f') value = digit - 'a' + 10;
+        else return false;
+        
+        int code = (value >> (cell % 2 * 2)) & 3;
+        if (code == 3) return false;
+        cells[cell] = (code == 1) ? PLAYER_X : ((code == 2) ? PLAYER_O : EMPTY_CELL);
+    }
+    return true;
+}
+
+// Начать запись партии с позиции start (пустое поле или загруженная игра)
+Replay createReplay(int game, int size, const string& start, char firstPlayer) {
+    Replay replay;
+    replay.game = game;
+    replay.size = size;
+    replay.cellCount = replayCellCount(game, size);
+    replay.interval = REPLAY_SNAPSHOT_INTERVAL;
+    replay.firstPlayer = firstPlayer;
+    replay.position = start;
+    replay.snapshots.push_back(packCells(start));
+    return replay;
+}
+
+// Поставить на поле ход номер index из записи (игроки чередуются, начиная с первого)
+void applyReplayMove(const Replay& replay, string& cells, int index) {
+    char player = (index % 2 == 0) ? replay.firstPlayer :
+                  ((replay.firstPlayer == PLAYER_X) ? PLAYER_O : PLAYER_X);
+    cells[replay.moves[index]] = player;
+}
+
+// Добавить ход в запись; снимок берется из поля, которое ведет сама запись
+void recordReplayMove(Replay& replay, int cell) {
+    replay.moves.push_back(cell);
+    applyReplayMove(replay, replay.position, replay.moves.size() - 1);
+    if (replay.moves.size() % replay.interval == 0) {
+        replay.snapshots.push_back(packCells(replay.position));
+    }
+}
+
+// Поле после ply ходов: ближайший снимок и не больше interval - 1 ходов после него
+string positionAtPly(const Replay& replay, int ply, int& appliedMoves) {
+    int snapshot = ply / replay.interval;
+    string cells;
+    unpackCells(replay.snapshots[snapshot], replay.cellCount, cells);
+    
+    appliedMoves = 0;
+    for (int i = snapshot * replay.interval; i < ply; i++) {
+        applyReplayMove(replay, cells, i);
+        appliedMoves++;
+    }
+    return cells;
+}
+
+// Ход в тех же обозначениях, что и при вводе: B3, в Qubic со слоем впереди - 2B3
+string replayMoveName(const Replay& replay, int cell) {
+    string name;
+    if (replay.game == REPLAY_QUBIC) {
+        name += char('1' + cell / (replay.size * replay.size));
+        cell %= replay.size * replay.size;
+    }
+    name += char('A' + cell / replay.size);
+    name += to_string(cell % replay.size + 1);
+    return name;
+}
+
+// Разобрать ход из файла записи
+bool parseReplayMove(const Replay& replay, const string& text, int& cell) {
+    if (replay.game == REPLAY_QUBIC) {
+        return isValidQubicMove(text, cell);
+    }
+    
+    int row, col;
+    if (!isValidMove(text, row, col, replay.size)) return false;
+    cell = row * replay.size + col;
+    return true;
+}
+
+// Сохранить запись партии в файл
+bool saveReplay(const string& fileName, const Replay& replay) {
+    ofstream file(fileName);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: не могу создать файл записи партии!\n", 31);
+        return false;
+    }
+    
+    // Заголовок: режим, размер поля, интервал снимков, первый игрок, число ходов и снимков
+    file << "REPLAY 2" << endl;
+    file << REPLAY_GAME_NAMES[replay.game] << " " << replay.size << " " << replay.interval << " "
+         << replay.firstPlayer << " " << replay.moves.size() << " " << replay.snapshots.size() << endl;
+    
+    // Снимки идут до ходов, чтобы найти нужный, не читая весь список ходов
+    for (size_t i = 0; i < replay.snapshots.size(); i++) {
+        file << replay.snapshots[i] << endl;
+    }
+    for (size_t i = 0; i < replay.moves.size(); i++) {
+        file << replayMoveName(replay, replay.moves[i]) << endl;
+    }
+    
+    file.close();
+    return true;
+}
+
+// Загрузить запись партии из файла.
+// Сама ничего не печатает: о поврежденном файле сообщает viewReplay
+bool loadReplay(const string& fileName, Replay& replay) {
+    ifstream file(fileName);
+    
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    // Первая версия формата (REPLAY 1) хранила только партии 3x3 и не называла режим
+    string line;
+    string gameName = REPLAY_GAME_NAMES[REPLAY_CLASSIC];
+    bool headerOK = getline(file, line) && (line == "REPLAY 1" || (line == "REPLAY 2" && file >> gameName));
+    replay.game = -1;
+    for (int game = REPLAY_CLASSIC; game <= REPLAY_QUBIC; game++) {
+        if (gameName == REPLAY_GAME_NAMES[game]) replay.game = game;
+    }
+    
+    size_t moveCount = 0;
+    size_t snapshotCount = 0;
+    if (!headerOK || replay.game == -1 ||
+        !(file >> replay.size >> replay.interval >> replay.firstPlayer >> moveCount >> snapshotCount) ||
+        replay.size < 1 || replay.size > 9 || replay.interval < 1 ||
+        (replay.game == REPLAY_ULTIMATE && replay.size != ULTIMATE_SIZE) ||
+        (replay.game == REPLAY_QUBIC && replay.size != QUBIC_SIZE) ||
+        (replay.firstPlayer != PLAYER_X && replay.firstPlayer != PLAYER_O) ||
+        moveCount > static_cast<size_t>(replayCellCount(replay.game, replay.size)) ||
+        snapshotCount != moveCount / replay.interval + 1) {
+        return false;
+    }
+    replay.cellCount = replayCellCount(replay.game, replay.size);
+    
+    replay.snapshots.assign(snapshotCount, "");
+    string check;
+    for (size_t i = 0; i < snapshotCount; i++) {
+        if (!(file >> replay.snapshots[i]) || !unpackCells(replay.snapshots[i], replay.cellCount, check)) {
+            return false;
+        }
+    }
+    
+    replay.moves.clear();
+    for (size_t i = 0; i < moveCount; i++) {
+        int cell;
+        if (!(file >> line) || !parseReplayMove(replay, line, cell)) {
+            return false;
+        }
+        replay.moves.push_back(cell);
+    }
+    
+    file.close();
+    
+    // Ходы проигрываются от начальной позиции: каждый должен попасть в пустую клетку,
+    // а поле после каждых interval ходов - совпасть со следующим снимком
+    unpackCells(replay.snapshots[0], replay.cellCount, replay.position);
+    for (size_t i = 0; i < moveCount; i++) {
+        if (replay.position[replay.moves[i]] != EMPTY_CELL) return false;
+        applyReplayMove(replay, replay.position, i);
+        if ((i + 1) % replay.interval == 0 &&
+            packCells(replay.position) != replay.snapshots[(i + 1) / replay.interval]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Сохранить запись партии в новый файл архива; пустая запись не сохраняется
+void storeReplay(const Replay& replay) {
+    if (replay.moves.empty()) return;
+    
+    // Имя по дате и времени окончания партии, при совпадении добавляется номер
+    char stamp[32];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now));
+    string fileName = REPLAY_PREFIX + stamp + REPLAY_EXTENSION;
+    for (int copy = 2; filesystem::exists(fileName); copy++) {
+        fileName = REPLAY_PREFIX + stamp + "_" + to_string(copy) + REPLAY_EXTENSION;
+    }
+    
+    if (saveReplay(fileName, replay)) {
+        cout << "Запись партии сохранена в файл: " << fileName << "\n";
+    }
+}
+
+// Все записи партий в текущей папке, от старых к новым
+vector<string> listReplayFiles() {
+    vector<string> files;
+    error_code error;
+    for (filesystem::directory_iterator it(".", error), end; !error && it != end; it.increment(error)) {
+        string name = it->path().filename().string();
+        if (name.compare(0, REPLAY_PREFIX.length(), REPLAY_PREFIX) == 0 &&
+            name.length() > REPLAY_EXTENSION.length() &&
+            name.compare(name.length() - REPLAY_EXTENSION.length(), REPLAY_EXTENSION.length(), REPLAY_EXTENSION) == 0) {
+            files.push_back(name);
+        }
+    }
+    // Имена содержат дату и время, поэтому сортировка по имени - хронологическая
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// Выигрышные линии малого поля 3x3 в виде битовых масок (бит клетки = строка * 3 + столбец)
+const vector<uint32_t> LINE_MASKS = buildLineMasks(3, 3);
+const uint16_t FULL_MASK = 0x1FF; // Все 9 клеток поля 3x3
+
+// Таблица: есть ли в маске из 9 бит собранная линия
+vector<char> buildLineTable() {
+    vector<char> table(FULL_MASK + 1, 0);
+    for (int mask = 0; mask <= FULL_MASK; mask++) {
+        table[mask] = maskHasLine(mask, LINE_MASKS) ? 1 : 0;
+    }
+    return table;
+}
+
+// Есть ли в маске собранная линия (проверка одним обращением к таблице)
+bool hasLine(uint16_t mask) {
+    static const vector<char> table = buildLineTable();
+    return table[mask] != 0;
+}
+
+// Ограничение поиска по времени
+struct SearchLimit {
+    chrono::steady_clock::time_point deadline;  // Когда нужно остановиться
+    long nodes;                                 // Сколько позиций просмотрено
+    bool stopped;                               // Время вышло, результат неполный
+};
+
+// Создать ограничение поиска на заданное число миллисекунд
+SearchLimit startSearchLimit(int timeLimitMs) {
+    SearchLimit limit;
+    limit.deadline = chrono::steady_clock::now() + chrono::milliseconds(timeLimitMs);
+    limit.nodes = 0;
+    limit.stopped = false;
+    return limit;
+}
+
+// Учесть позицию и проверить время (часы опрашиваются раз в 1024 позиции)
+bool searchTimeIsUp(SearchLimit& limit) {
+    limit.nodes++;
+    if ((limit.nodes & 1023) == 0 && chrono::steady_clock::now() >= limit.deadline) {
+        limit.stopped = true;
+    }
+    return limit.stopped;
+}
+
+// Поле Ultimate: вложенные битовые доски
+struct UltimateBoard {
+    uint16_t cells[2][9];  // [игрок][малое поле] -> маска занятых клеток
+    uint16_t won[2];       // Маски малых полей, выигранных каждым игроком
+    uint16_t closed;       // Маска закрытых малых полей (выиграно или заполнено)
+    int nextSubBoard;      // Куда обязан ходить следующий игрок (ANY_SUB_BOARD - любое)
+    int sideToMove;        // Чей ход: 0 - X, 1 - O
+    int result;            // -1 - игра идет, 0 - победил X, 1 - победил O, 2 - ничья
+};
+
+// Ход в Ultimate кодируется числом: малое поле * 9 + клетка внутри него
+int ultimateMoveFromCoords(int row, int col) {
+    return (row / 3 * 3 + col / 3) * 9 + (row % 3 * 3 + col % 3);
+}
+
+// Общие координаты клетки по коду хода (обратно к ultimateMoveFromCoords)
+void ultimateMoveToCoords(int move, int& row, int& col) {
+    row = move / 9 / 3 * 3 + move % 9 / 3;
+    col = move / 9 % 3 * 3 + move % 9 % 3;
+}
+
+// Создание пустого поля Ultimate
+UltimateBoard createUltimateBoard(char firstPlayer) {
+    UltimateBoard board;
+    for (int p = 0; p < 2; p++) {
+        for (int sub = 0; sub < 9; sub++) {
+            board.cells[p][sub] = 0;
+        }
+        board.won[p] = 0;
+    }
+    board.closed = 0;
+    board.nextSubBoard = ANY_SUB_BOARD;
+    board.sideToMove = (firstPlayer == PLAYER_X) ? 0 : 1;
+    board.result = -1;
+    return board;
+}
+
+// Сгенерировать все допустимые ходы, возвращает их количество
+int generateUltimateMoves(const UltimateBoard& board, int moves[81]) {
+    int count = 0;
+    if (board.result != -1) return 0;
+    
+    for (int sub = 0; sub < 9; sub++) {
+        if (board.nextSubBoard != ANY_SUB_BOARD && sub != board.nextSubBoard) continue;
+        if (board.closed & (1 << sub)) continue;
+        
+        // Свободные клетки малого поля - одна операция над масками
+        uint16_t freeCells = ~(board.cells[0][sub] | board.cells[1][sub]) & FULL_MASK;
+        for (int cell = 0; cell < 9; cell++) {
+            if (freeCells & (1 << cell)) {
+                moves[count++] = sub * 9 + cell;
+            }
+        }
+    }
+    return count;
+}
+
+// Проверка, что ход допустим в текущей позиции
+bool isLegalUltimateMove(const UltimateBoard& board, int move) {
+    int moves[81];
+    int count = generateUltimateMoves(board, moves);
+    for (int i = 0; i < count; i++) {
+        if (moves[i] == move) return true;
+    }
+    return false;
+}
+
+// Сделать ход; выигрыш проверяется только в затронутом малом поле и на большом поле
+void applyUltimateMove(UltimateBoard& board, int move) {
+    int sub = move / 9;
+    int cell = move % 9;
+    int side = board.sideToMove;
+    
+    board.cells[side][sub] |= static_cast<uint16_t>(1 << cell);
+    
+    if (hasLine(board.cells[side][sub])) {
+        board.won[side] |= static_cast<uint16_t>(1 << sub);
+        board.closed |= static_cast<uint16_t>(1 << sub);
+        if (hasLine(board.won[side])) {
+            board.result = side;
+        }
+    } else if ((board.cells[0][sub] | board.cells[1][sub]) == FULL_MASK) {
+        board.closed |= static_cast<uint16_t>(1 << sub);
+    }
+    
+    // Все малые поля закрыты, а линии на большом поле нет - ничья
+    if (board.result == -1 && board.closed == FULL_MASK) {
+        board.result = 2;
+    }
+    
+    // Клетка хода определяет малое поле для соперника
+    board.nextSubBoard = (board.closed & (1 << cell)) ? ANY_SUB_BOARD : cell;
+    board.sideToMove = 1 - side;
+}
+
+// Оценка линий одного поля 3x3: почти собранные линии без фишек соперника
+// (blocked - клетки, которые не достанутся никому, они закрывают линию для обоих)
+int evaluateLines(uint16_t own, uint16_t other, uint16_t blocked, int twoWeight, int oneWeight) {
+    int score = 0;
+    for (size_t line = 0; line < LINE_MASKS.size(); line++) {
+        uint16_t ownPart = own & LINE_MASKS[line];
+        uint16_t otherPart = other & LINE_MASKS[line];
+        if (ownPart != 0 && otherPart != 0) continue;  // Линия заблокирована
+        if (blocked & LINE_MASKS[line]) continue;
+        
+        uint16_t part = ownPart ? ownPart : otherPart;
+        int sign = ownPart ? 1 : -1;
+        int pieces = 0;
+        for (uint16_t m = part; m != 0; m &= m - 1) pieces++;
+        
+        if (pieces == 2) score += sign * twoWeight;
+        else if (pieces == 1) score += sign * oneWeight;
+    }
+    return score;
+}
+
+// Статическая оценка позиции с точки зрения игрока, который ходит
+int evaluateUltimate(const UltimateBoard& board) {
+    int side = board.sideToMove;
+    int other = 1 - side;
+    
+    // Большое поле: выигранные малые поля и угрозы собрать линию из них.
+    // Ничейные малые поля блокируют линии обоих игроков.
+    uint16_t drawn = board.closed & ~(board.won[0] | board.won[1]);
+    int score = evaluateLines(board.won[side], board.won[other], drawn, 300, 40);
+    for (int sub = 0; sub < 9; sub++) {
+        if (drawn & (1 << sub)) continue;
+        int weight = (sub == 4) ? 3 : ((sub % 2 == 0) ? 2 : 1);  // Центр, углы, края
+        if (board.won[side] & (1 << sub)) score += 100 * weight;
+        if (board.won[other] & (1 << sub)) score -= 100 * weight;
+    }
+    
+    // Открытые малые поля: угрозы и центральная клетка
+    for (int sub = 0; sub < 9; sub++) {
+        if (board.closed & (1 << sub)) continue;
+        score += evaluateLines(board.cells[side][sub], board.cells[other][sub], 0, 8, 1);
+        if (board.cells[side][sub] & 0x010) score += 3;
+        if (board.cells[other][sub] & 0x010) score -= 3;
+    }
+    
+    // Право хода в любое малое поле - преимущество
+    if (board.nextSubBoard == ANY_SUB_BOARD) score += 15;
+    
+    return score;
+}
+
+// Поиск лучшего хода: негамакс с альфа-бета отсечением
+int searchUltimate(const UltimateBoard& board, int depth, int alpha, int beta, int ply, SearchLimit& limit) {
+    if (board.result != -1) {
+        if (board.result == 2) return 0;
+        // Последний ход сделал соперник, значит проиграл тот, кто ходит; быстрый проигрыш хуже
+        return -WIN_SCORE + ply;
+    }
+    if (depth == 0 || searchTimeIsUp(limit)) {
+        return evaluateUltimate(board);
+    }
+    
+    int moves[81];
+    int count = generateUltimateMoves(board, moves);
+    for (int i = 0; i < count; i++) {
+        UltimateBoard child = board;
+        applyUltimateMove(child, moves[i]);
+        int score = -searchUltimate(child, depth - 1, -beta, -alpha, ply + 1, limit);
+        if (limit.stopped) return 0;
+        
+        if (score > alpha) {
+            alpha = score;
+            if (alpha >= beta) break;  // Соперник не допустит эту позицию
+        }
+    }
+    return alpha;
+}
+
+// Выбрать ход компьютера: углубляем поиск, пока хватает времени
+int findUltimateMove(const UltimateBoard& board, int timeLimitMs, int& reachedDepth) {
+    int moves[81];
+    int count = generateUltimateMoves(board, moves);
+    int bestMove = moves[0];
+    reachedDepth = 0;
+    SearchLimit limit = startSearchLimit(timeLimitMs);
+    
+    for (int depth = 1; depth <= 81; depth++) {
+        int iterationBest = -1;
+        int alpha = -WIN_SCORE - 1;
+        
+        for (int i = 0; i < count; i++) {
+            UltimateBoard child = board;
+            applyUltimateMove(child, moves[i]);
+            int score = -searchUltimate(child, depth - 1, -WIN_SCORE - 1, -alpha, 1, limit);
+            if (limit.stopped) break;
+            
+            if (score > alpha) {
+                alpha = score;
+                iterationBest = i;
+            }
+        }
+        
+        // Незаконченная итерация не используется
+        if (limit.stopped || iterationBest < 0) break;
+        
+        bestMove = moves[iterationBest];
+        reachedDepth = depth;
+        // Лучший ход ставим первым, чтобы следующая итерация отсекала больше
+        rotate(moves, moves + iterationBest, moves + iterationBest + 1);
+        
+        if (alpha >= WIN_SCORE - 81 || alpha <= -WIN_SCORE + 81) break;  // Исход уже известен
+    }
+    return bestMove;
+}
+
+// Символ клетки поля Ultimate по общим координатам
+char ultimateCell(const UltimateBoard& board, int row, int col) {
+    int move = ultimateMoveFromCoords(row, col);
+    uint16_t bit = static_cast<uint16_t>(1 << (move % 9));
+    if (board.cells[0][move / 9] & bit) return PLAYER_X;
+    if (board.cells[1][move / 9] & bit) return PLAYER_O;
+    return EMPTY_CELL;
+}
+
+// Поле Ultimate по клеткам 9x9 из записи партии; lastMove - клетка последнего хода или -1.
+// Выигранные и заполненные малые поля закрываются так же, как в applyUltimateMove
+UltimateBoard ultimateBoardFromCells(const string& cells, int lastMove, char playerToMove) {
+    UltimateBoard board = createUltimateBoard(playerToMove);
+    for (int cell = 0; cell < ULTIMATE_SIZE * ULTIMATE_SIZE; cell++) {
+        if (cells[cell] == EMPTY_CELL) continue;
+        int move = ultimateMoveFromCoords(cell / ULTIMATE_SIZE, cell % ULTIMATE_SIZE);
+        int side = (cells[cell] == PLAYER_X) ? 0 : 1;
+        board.cells[side][move / 9] |= static_cast<uint16_t>(1 << (move % 9));
+    }
+    
+    for (int sub = 0; sub < 9; sub++) {
+        for (int side = 0; side < 2; side++) {
+            if (hasLine(board.cells[side][sub])) {
+                board.won[side] |= static_cast<uint16_t>(1 << sub);
+                board.closed |= static_cast<uint16_t>(1 << sub);
+            }
+        }
+        if ((board.cells[0][sub] | board.cells[1][sub]) == FULL_MASK) {
+            board.closed |= static_cast<uint16_t>(1 << sub);
+        }
+    }
+    if (hasLine(board.won[0])) board.result = 0;
+    else if (hasLine(board.won[1])) board.result = 1;
+    else if (board.closed == FULL_MASK) board.result = 2;
+    
+    if (lastMove >= 0) {
+        int target = ultimateMoveFromCoords(lastMove / ULTIMATE_SIZE, lastMove % ULTIMATE_SIZE) % 9;
+        board.nextSubBoard = (board.closed & (1 << target)) ? ANY_SUB_BOARD : target;
+    }
+    return board;
+}
+
+// Вывод поля Ultimate в тех же координатах, что и displayBoard (буква строки + цифра столбца)
+void displayUltimateBoard(const UltimateBoard& board) {
+    cout << "\n";
+    cout << "    1   2   3   4   5   6   7   8   9\n";  // Номера столбцов
+    cout << "  +===+===+===+===+===+===+===+===+===+\n";
+    
+    for (int row = 0; row < ULTIMATE_SIZE; row++) {
+        cout << char('A' + row) << " ";
+        
+        for (int col = 0; col < ULTIMATE_SIZE; col++) {
+            // Границы малых полей выделяем желтым цветом
+            if (col % 3 == 0) printColor("#", 33);
+            else cout << "|";
+            cout << " ";
+            
+            int sub = row / 3 * 3 + col / 3;
+            char cell = ultimateCell(board, row, col);
+            if (cell == PLAYER_X) {
+                printColor(string(1, cell), 31);  // Красный для X
+            } else if (cell == PLAYER_O) {
+                printColor(string(1, cell), 34);  // Синий для O
+            } else if (board.result == -1 && !(board.closed & (1 << sub)) &&
+                       (board.nextSubBoard == ANY_SUB_BOARD || board.nextSubBoard == sub)) {
+                printColor(".", 32);  // Зеленая точка - сюда можно ходить
+            } else {
+                cout << cell;
+            }
+            cout << " ";
+        }
+        printColor("#", 33);
+        cout << "\n";
+        
+        if (row % 3 == 2) {
+            cout << "  +===+===+===+===+===+===+===+===+===+\n";  // Граница малых полей
+        } else {
+            cout << "  +---+---+---+---+---+---+---+---+---+\n";
+        }
+    }
+    
+    // Большое поле показываем обычной доской 3x3
+    GameBoard meta = createEmptyBoard();
+    for (int sub = 0; sub < 9; sub++) {
+        if (board.won[0] & (1 << sub)) meta[sub / 3][sub % 3] = PLAYER_X;
+        if (board.won[1] & (1 << sub)) meta[sub / 3][sub % 3] = PLAYER_O;
+    }
+    cout << "Большое поле:";
+    displayBoard(meta);
+}
+
+// Правила Ultimate
+void showUltimateRules() {
+    printHeader();
+    printColor("----ПРАВИЛА ULTIMATE----\n", 33);
+    
+    cout << "\n1. Поле 9x9 состоит из 9 малых полей 3x3\n";
+    cout << "2. Клетка, в которую вы походили, определяет\n";
+    cout << "   малое поле, где должен ходить соперник\n";
+    cout << "3. Если это поле уже выиграно или заполнено,\n";
+    cout << "   соперник ходит в любое открытое поле\n";
+    cout << "4. Собрав линию в малом поле, вы выигрываете его\n";
+    cout << "5. Победит тот, кто соберет линию из малых полей\n";
+    cout << "   на большом поле\n";
+    cout << "6. Допустимые клетки отмечены ";
+    printColor(".", 32);
+    cout << ", ход вводится так же: ";
+    printColor("E5\n", 32);
+    
+    waitForEnter();
+}
+
+// Игра в Ultimate: два игрока или против компьютера
+void playUltimate() {
+    printHeader();
+    printColor("----ULTIMATE----\n", 33);
+    cout << "\n1. Два игрока\n";
+    cout << "2. Против компьютера (вы играете за X)\n";
+    cout << "3. Против компьютера (вы играете за O)\n";
+    
+    int mode = getValidNumber("Ваш выбор (1-3): ", 1, 3);
+    // Номер стороны компьютера: 0 - X, 1 - O, -1 - компьютер не играет
+    int computerSide = (mode == 2) ? 1 : ((mode == 3) ? 0 : -1);
+    
+    UltimateBoard board = createUltimateBoard(PLAYER_X);
+    // Запись партии ведется в координатах поля 9x9, как при вводе хода
+    Replay replay = createReplay(REPLAY_ULTIMATE, ULTIMATE_SIZE, string(ULTIMATE_SIZE * ULTIMATE_SIZE, EMPTY_CELL), PLAYER_X);
+    int moveCount = 0;
+    string lastComputerMove = "";
+    
+    while (board.result == -1) {
+        printHeader();
+        displayUltimateBoard(board);
+        
+        char currentPlayer = (board.sideToMove == 0) ? PLAYER_X : PLAYER_O;
+        if (!lastComputerMove.empty()) {
+            cout << lastComputerMove << "\n";
+        }
+        cout << "Ход #" << (moveCount + 1) << "\n";
+        cout << "Текущий игрок: ";
+        printColor(string(1, currentPlayer) + "\n", (currentPlayer == PLAYER_X) ? 31 : 34);
+        
+        int move;
+        if (board.sideToMove == computerSide) {
+            int depth = 0;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            move = findUltimateMove(board, ULTIMATE_TIME_LIMIT_MS, depth);
+            long elapsed = static_cast<long>(chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - start).count());
+            
+            int row, col;
+            ultimateMoveToCoords(move, row, col);
+            lastComputerMove = "Компьютер сходил " + string(1, char('A' + row)) + to_string(col + 1) +
+                               " (глубина " + to_string(depth) + ", " + to_string(elapsed) + " мс)";
+        } else {
+            cout << "\nВведите ход (например, E5) или команду: ";
+            string input;
+            getline(cin, input);
+            input = trimString(input);
+            
+            if (input == "help" || input == "Help") {
+                showUltimateRules();
+                continue;
+            }
+            
+            if (input == "menu" || input == "Menu") {
+                cout << "\nВыйти в главное меню? (да/нет): ";
+                string answer = getChoice("");
+                if (answer == "да") {
+                    storeReplay(replay);  // Недоигранная партия тоже попадает в архив
+                    return;
+                }
+                continue;
+            }
+            
+            int row, col;
+            if (!isValidMove(input, row, col, ULTIMATE_SIZE)) {
+                printColor("Ошибка: неправильный формат хода!\n", 31);
+                cout << "Используйте: A1, E5, I9 и т.д.\n";
+                waitForEnter();
+                continue;
+            }
+            
+            move = ultimateMoveFromCoords(row, col);
+            if (!isLegalUltimateMove(board, move)) {
+                printColor("Ошибка: сюда ходить нельзя!\n", 31);
+                cout << "Допустимые клетки отмечены точкой.\n";
+                waitForEnter();
+                continue;
+            }
+        }
+        
+        applyUltimateMove(board, move);
+        int moveRow, moveCol;
+        ultimateMoveToCoords(move, moveRow, moveCol);
+        recordReplayMove(replay, moveRow * ULTIMATE_SIZE + moveCol);
+        moveCount++;
+    }
+    
+    printHeader();
+    displayUltimateBoard(board);
+    if (!lastComputerMove.empty()) {
+        cout << lastComputerMove << "\n";
+    }
+    
+    cout << "\n";
+    printColor("----------------------------------------\n", 33);
+    if (board.result == 2) {
+        printColor("           НИЧЬЯ!\n", 34);
+    } else {
+        printColor("     ПОБЕДИЛ ИГРОК " + string(1, (board.result == 0) ? PLAYER_X : PLAYER_O) + "!\n", 32);
+    }
+    printColor("----------------------------------------\n", 33);
+    
+    cout << "\nВсего ходов: " << moveCount << endl;
+    storeReplay(replay);
+    waitForEnter();
+}
+
+// Все линии куба 4x4x4 и линии через каждую клетку (клетка = слой * 16 + строка * 4 + столбец)
+struct QubicTables {
+    vector<uint64_t> lines;           // 76 выигрышных линий в виде масок
+    vector<vector<int> > cellLines;   // Номера линий, проходящих через клетку (4 или 7)
+    uint64_t zobrist[2][QUBIC_CELLS]; // Случайные ключи для хеша позиции
+    uint64_t sideKey;                 // Ключ стороны, которая ходит
+};
+
+// Построить таблицы линий и ключей хеша (генератор с фиксированным зерном,
+// чтобы хеши позиций не менялись между запусками)
+QubicTables buildQubicTables() {
+    QubicTables tables;
+    tables.cellLines.assign(QUBIC_CELLS, vector<int>());
+    
+    // Перебираем 13 направлений: первая ненулевая координата направления положительна
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int first = (dz != 0) ? dz : ((dy != 0) ? dy : dx);
+                if (first <= 0) continue;
+                
+                for (int z = 0; z < QUBIC_SIZE; z++) {
+                    for (int y = 0; y < QUBIC_SIZE; y++) {
+                        for (int x = 0; x < QUBIC_SIZE; x++) {
+                            // Линия должна целиком помещаться в куб
+                            int endZ = z + dz * (QUBIC_SIZE - 1);
+                            int endY = y + dy * (QUBIC_SIZE - 1);
+                            int endX = x + dx * (QUBIC_SIZE - 1);
+                            if (endZ < 0 || endZ >= QUBIC_SIZE || endY < 0 || endY >= QUBIC_SIZE ||
+                                endX < 0 || endX >= QUBIC_SIZE) continue;
+                            
+                            uint64_t mask = 0;
+                            for (int step = 0; step < QUBIC_SIZE; step++) {
+                                int cell = (z + dz * step) * 16 + (y + dy * step) * 4 + (x + dx * step);
+                                mask |= 1ULL << cell;
+                            }
+                            tables.lines.push_back(mask);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    for (size_t line = 0; line < tables.lines.size(); line++) {
+        for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+            if (tables.lines[line] & (1ULL << cell)) {
+                tables.cellLines[cell].push_back(static_cast<int>(line));
+            }
+        }
+    }
+    
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int p = 0; p < 2; p++) {
+        for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+            // Генератор xorshift64
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            tables.zobrist[p][cell] = seed;
+        }
+    }
+    seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+    tables.sideKey = seed;
+    
+    return tables;
+}
+
+// Таблицы строятся один раз при первом обращении
+const QubicTables& qubicTables() {
+    static const QubicTables tables = buildQubicTables();
+    return tables;
+}
+
+// Позиция Qubic: по 64-битной маске на игрока
+struct QubicBoard {
+    uint64_t pieces[2];  // [игрок] -> занятые клетки: 0 - X, 1 - O
+    int sideToMove;      // Чей ход: 0 - X, 1 - O
+    int result;          // -1 - игра идет, 0 - победил X, 1 - победил O, 2 - ничья
+    uint64_t hash;       // Хеш позиции для таблицы транспозиций
+};
+
+// Создание пустого куба
+QubicBoard createQubicBoard(char firstPlayer) {
+    QubicBoard board;
+    board.pieces[0] = 0;
+    board.pieces[1] = 0;
+    board.sideToMove = (firstPlayer == PLAYER_X) ? 0 : 1;
+    board.result = -1;
+    board.hash = (board.sideToMove == 1) ? qubicTables().sideKey : 0;
+    return board;
+}
+
+// Выиграл ли ход: проверяются только линии через поставленную клетку
+bool qubicMoveWins(uint64_t pieces, int cell) {
+    const QubicTables& tables = qubicTables();
+    const vector<int>& cellLines = tables.cellLines[cell];
+    for (size_t i = 0; i < cellLines.size(); i++) {
+        uint64_t line = tables.lines[cellLines[i]];
+        if ((pieces & line) == line) return true;
+    }
+    return false;
+}
+
+// Сделать ход в кубе (клетка должна быть свободна)
+void applyQubicMove(QubicBoard& board, int cell) {
+    const QubicTables& tables = qubicTables();
+    int side = board.sideToMove;
+    
+    board.pieces[side] |= 1ULL << cell;
+    board.hash ^= tables.zobrist[side][cell] ^ tables.sideKey;
+    
+    if (qubicMoveWins(board.pieces[side], cell)) {
+        board.result = side;
+    } else if ((board.pieces[0] | board.pieces[1]) == ~0ULL) {
+        board.result = 2;
+    }
+    board.sideToMove = 1 - side;
+}
+
+// Клетки, заняв которые игрок сразу соберет линию
+uint64_t qubicThreats(uint64_t own, uint64_t other) {
+    const QubicTables& tables = qubicTables();
+    uint64_t threats = 0;
+    for (size_t i = 0; i < tables.lines.size(); i++) {
+        uint64_t line = tables.lines[i];
+        if ((other & line) == 0 && __builtin_popcountll(own & line) == QUBIC_SIZE - 1) {
+            threats |= line & ~own;
+        }
+    }
+    return threats;
+}
+
+// Статическая оценка с точки зрения игрока, который ходит:
+// открытые линии ценятся тем выше, чем больше в них фишек
+int evaluateQubic(const QubicBoard& board) {
+    static const int weights[QUBIC_SIZE] = {0, 1, 6, 40};
+    const QubicTables& tables = qubicTables();
+    uint64_t own = board.pieces[board.sideToMove];
+    uint64_t other = board.pieces[1 - board.sideToMove];
+    
+    int score = 0;
+    for (size_t i = 0; i < tables.lines.size(); i++) {
+        uint64_t line = tables.lines[i];
+        int ownCount = __builtin_popcountll(own & line);
+        int otherCount = __builtin_popcountll(other & line);
+        if (otherCount == 0) score += weights[ownCount];
+        else if (ownCount == 0) score -= weights[otherCount];
+    }
+    return score;
+}
+
+// Запись таблицы транспозиций
+struct QubicEntry {
+    uint64_t key;    // Полный хеш позиции для проверки совпадения
+    int score;       // Оценка позиции
+    int8_t depth;    // Глубина, на которой получена оценка
+    uint8_t flag;    // Точная оценка, нижняя или верхняя граница
+    int8_t move;     // Лучший найденный ход (-1 - нет)
+};
+
+const uint8_t TT_EXACT = 0; // Оценка точная
+const uint8_t TT_LOWER = 1; // Оценка не меньше сохраненной
+const uint8_t TT_UPPER = 2; // Оценка не больше сохраненной
+
+// Движок Qubic: таблица транспозиций и история ходов живут всю партию
+struct QubicEngine {
+    vector<QubicEntry> table;   // Таблица транспозиций
+    int history[QUBIC_CELLS];   // Как часто ход давал отсечение
+    SearchLimit limit;          // Ограничение времени текущего поиска
+};
+
+// Создать движок с пустой таблицей транспозиций
+QubicEngine createQubicEngine() {
+    QubicEngine engine;
+    QubicEntry empty = {0, 0, -1, TT_EXACT, -1};
+    engine.table.assign(QUBIC_TABLE_SIZE, empty);
+    for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+        engine.history[cell] = 0;
+    }
+    engine.limit = startSearchLimit(0);
+    return engine;
+}
+
+// Оценки выигрыша хранятся относительно позиции, а не корня поиска
+int scoreToTable(int score, int ply) {
+    if (score > WIN_SCORE - 1000) return score + ply;
+    if (score < -WIN_SCORE + 1000) return score - ply;
+    return score;
+}
+
+int scoreFromTable(int score, int ply) {
+    if (score > WIN_SCORE - 1000) return score - ply;
+    if (score < -WIN_SCORE + 1000) return score + ply;
+    return score;
+}
+
+// Поиск: негамакс с альфа-бета отсечением, таблицей транспозиций
+// и обязательной защитой от угрозы соперника
+int searchQubic(QubicEngine& engine, const QubicBoard& board, int depth, int alpha, int beta, int ply) {
+    if (searchTimeIsUp(engine.limit)) return 0;
+    
+    uint64_t own = board.pieces[board.sideToMove];
+    uint64_t other = board.pieces[1 - board.sideToMove];
+    uint64_t freeCells = ~(own | other);
+    if (freeCells == 0) return 0;
+    
+    // Своя готовая линия - выигрыш следующим ходом
+    if (qubicThreats(own, other) & freeCells) return WIN_SCORE - ply - 1;
+    
+    // Две угрозы соперника закрыть нельзя
+    uint64_t mustBlock = qubicThreats(other, own) & freeCells;
+    if (__builtin_popcountll(mustBlock) >= 2) return -WIN_SCORE + ply + 2;
+    
+    if (depth <= 0 && mustBlock == 0) return evaluateQubic(board);
+    
+    QubicEntry& entry = engine.table[board.hash & (QUBIC_TABLE_SIZE - 1)];
+    int ttMove = -1;
+    if (entry.key == board.hash) {
+        ttMove = entry.move;
+        if (entry.depth >= depth) {
+            int stored = scoreFromTable(entry.score, ply);
+            if (entry.flag == TT_EXACT) return stored;
+            if (entry.flag == TT_LOWER && stored >= beta) return stored;
+            if (entry.flag == TT_UPPER && stored <= alpha) return stored;
+        }
+    }
+    
+    // Под угрозой единственный ход - закрыть линию; вынужденный ход не уменьшает глубину
+    int moves[QUBIC_CELLS];
+    int count = 0;
+    int nextDepth = depth - 1;
+    if (mustBlock != 0) {
+        moves[count++] = __builtin_ctzll(mustBlock);
+        nextDepth = depth;
+    } else {
+        for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+            if (freeCells & (1ULL << cell)) moves[count++] = cell;
+        }
+        // Сначала ход из таблицы, затем ходы с лучшей историей и клетки на 7 линиях
+        const QubicTables& tables = qubicTables();
+        int keys[QUBIC_CELLS];
+        for (int i = 0; i < count; i++) {
+            int cell = moves[i];
+            keys[i] = (cell == ttMove) ? 1000000000 :
+                      engine.history[cell] * 8 + static_cast<int>(tables.cellLines[cell].size());
+        }
+        // Сортировка вставками: ходов не больше 64
+        for (int i = 1; i < count; i++) {
+            int move = moves[i];
+            int key = keys[i];
+            int j = i - 1;
+            while (j >= 0 && keys[j] < key) {
+                moves[j + 1] = moves[j];
+                keys[j + 1] = keys[j];
+                j--;
+            }
+            moves[j + 1] = move;
+            keys[j + 1] = key;
+        }
+    }
+    
+    int originalAlpha = alpha;
+    int bestScore = -WIN_SCORE - 1;
+    int bestMove = moves[0];
+    for (int i = 0; i < count; i++) {
+        QubicBoard child = board;
+        applyQubicMove(child, moves[i]);
+        int score = -searchQubic(engine, child, nextDepth, -beta, -alpha, ply + 1);
+        if (engine.limit.stopped) return 0;
+        
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = moves[i];
+        }
+        if (score > alpha) alpha = score;
+        if (alpha >= beta) {
+            engine.history[moves[i]] += depth * depth;
+            break;
+        }
+    }
+    
+    // Сохраняем результат; более глубокие записи не затираем чужими позициями
+    if (entry.key != board.hash || depth >= entry.depth) {
+        entry.key = board.hash;
+        entry.score = scoreToTable(bestScore, ply);
+        entry.depth = static_cast<int8_t>(depth);
+        entry.move = static_cast<int8_t>(bestMove);
+        if (bestScore <= originalAlpha) entry.flag = TT_UPPER;
+        else if (bestScore >= beta) entry.flag = TT_LOWER;
+        else entry.flag = TT_EXACT;
+    }
+    return bestScore;
+}
+
+// Выбрать ход компьютера в Qubic: углубляем поиск, пока хватает времени
+int findQubicMove(QubicEngine& engine, const QubicBoard& board, int timeLimitMs, int& reachedDepth) {
+    uint64_t own = board.pieces[board.sideToMove];
+    uint64_t other = board.pieces[1 - board.sideToMove];
+    uint64_t freeCells = ~(own | other);
+    reachedDepth = 0;
+    
+    // Выигрыш в один ход и вынужденная защита не требуют поиска
+    uint64_t wins = qubicThreats(own, other) & freeCells;
+    if (wins != 0) return __builtin_ctzll(wins);
+    uint64_t blocks = qubicThreats(other, own) & freeCells;
+    if (blocks != 0) return __builtin_ctzll(blocks);
+    
+    int moves[QUBIC_CELLS];
+    int count = 0;
+    for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+        if (freeCells & (1ULL << cell)) moves[count++] = cell;
+    }
+    // Клетки на 7 линиях (углы и центр куба) проверяем первыми
+    const QubicTables& tables = qubicTables();
+    for (int i = 1; i < count; i++) {
+        int move = moves[i];
+        int j = i - 1;
+        while (j >= 0 && tables.cellLines[moves[j]].size() < tables.cellLines[move].size()) {
+            moves[j + 1] = moves[j];
+            j--;
+        }
+        moves[j + 1] = move;
+    }
+    
+    int bestMove = moves[0];
+    engine.limit = startSearchLimit(timeLimitMs);
+    for (int depth = 1; depth <= count; depth++) {
+        int iterationBest = -1;
+        int alpha = -WIN_SCORE - 1;
+        
+        for (int i = 0; i < count; i++) {
+            QubicBoard child = board;
+            applyQubicMove(child, moves[i]);
+            int score = -searchQubic(engine, child, depth - 1, -WIN_SCORE - 1, -alpha, 1);
+            if (engine.limit.stopped) break;
+            
+            if (score > alpha) {
+                alpha = score;
+                iterationBest = i;
+            }
+        }
+        
+        // Незаконченная итерация не используется
+        if (engine.limit.stopped || iterationBest < 0) break;
+        
+        bestMove = moves[iterationBest];
+        reachedDepth = depth;
+        rotate(moves, moves + iterationBest, moves + iterationBest + 1);
+        
+        if (alpha >= WIN_SCORE - 1000 || alpha <= -WIN_SCORE + 1000) break;  // Исход уже известен
+    }
+    return bestMove;
+}
+
+// Символ клетки куба
+char qubicCell(const QubicBoard& board, int cell) {
+    if (board.pieces[0] & (1ULL << cell)) return PLAYER_X;
+    if (board.pieces[1] & (1ULL << cell)) return PLAYER_O;
+    return EMPTY_CELL;
+}
+
+// Клетки куба строкой (клетка = слой * 16 + строка * 4 + столбец)
+string qubicBoardCells(const QubicBoard& board) {
+    string cells;
+    for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+        cells += qubicCell(board, cell);
+    }
+    return cells;
+}
+
+// Позиция Qubic по строке клеток; итог партии определяется по линиям
+QubicBoard qubicBoardFromCells(const string& cells, char currentPlayer) {
+    QubicBoard board = createQubicBoard(currentPlayer);
+    const QubicTables& tables = qubicTables();
+    for (int cell = 0; cell < QUBIC_CELLS; cell++) {
+        if (cells[cell] == EMPTY_CELL) continue;
+        int side = (cells[cell] == PLAYER_X) ? 0 : 1;
+        board.pieces[side] |= 1ULL << cell;
+        board.hash ^= tables.zobrist[side][cell];
+    }
+    
+    for (size_t i = 0; i < tables.lines.size(); i++) {
+        if ((board.pieces[0] & tables.lines[i]) == tables.lines[i]) board.result = 0;
+        if ((board.pieces[1] & tables.lines[i]) == tables.lines[i]) board.result = 1;
+    }
+    if (board.result == -1 && (board.pieces[0] | board.pieces[1]) == ~0ULL) {
+        board.result = 2;
+    }
+    return board;
+}
+
+// Запись дебютной книги: статистика хода из позиции (записи лежат в файле как есть)
+struct BookEntry {
+    uint64_t hash;    // Хеш позиции до хода
+    uint32_t games;   // Сколько раз ход сыгран в самоигре
+    uint32_t points;  // Очки сходившего: 2 за победу, 1 за ничью
+    uint8_t move;     // Клетка хода
+    uint8_t reserved[7];
+};
+
+// Порядок записей в книге: по хешу позиции, затем по ходу
+bool bookEntryLess(const BookEntry& a, const BookEntry& b) {
+    if (a.hash != b.hash) return a.hash < b.hash;
+    return a.move < b.move;
+}
+
+// Упорядочить записи и сложить статистику одинаковых пар (позиция, ход)
+void compactBookEntries(vector<BookEntry>& entries) {
+    sort(entries.begin(), entries.end(), bookEntryLess);
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (kept > 0 && entries[kept - 1].hash == entries[i].hash && entries[kept - 1].move == entries[i].move) {
+            entries[kept - 1].games += entries[i].games;
+            entries[kept - 1].points += entries[i].points;
+        } else {
+            entries[kept++] = entries[i];
+        }
+    }
+    entries.resize(kept);
+}
+
+// Слить две упорядоченные книги за один проход
+vector<BookEntry> mergeBooks(const vector<BookEntry>& first, const vector<BookEntry>& second) {
+    vector<BookEntry> merged;
+    merged.reserve(first.size() + second.size());
+    size_t i = 0, j = 0;
+    while (i < first.size() || j < second.size()) {
+        if (j == second.size() || (i < first.size() && bookEntryLess(first[i], second[j]))) {
+            merged.push_back(first[i++]);
+        } else if (i == first.size() || bookEntryLess(second[j], first[i])) {
+            merged.push_back(second[j++]);
+        } else {
+            // Одна и та же пара в обеих книгах - статистика складывается
+            BookEntry entry = first[i++];
+            entry.games += second[j].games;
+            entry.points += second[j++].points;
+            merged.push_back(entry);
+        }
+    }
+    return merged;
+}
+
+// Сохранить книгу: заголовок, количество записей и сами записи одним блоком.
+// Пишем во временный файл и переименовываем: оборванная запись не испортит книгу
+bool saveOpeningBook(const string& fileName, const vector<BookEntry>& book) {
+    ofstream file(fileName + ".tmp", ios::binary);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: не могу создать файл дебютной книги!\n", 31);
+        return false;
+    }
+    
+    uint32_t count = static_cast<uint32_t>(book.size());
+    file.write("QBOOK1", 6);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(book.data()), book.size() * sizeof(BookEntry));
+    
+    file.close();
+    if (!file || rename((fileName + ".tmp").c_str(), fileName.c_str()) != 0) {
+        printColor("Ошибка: не удалось записать дебютную книгу!\n", 31);
+        return false;
+    }
+    return true;
+}
+
+// Загрузить книгу одним чтением, без разбора записей.
+// Сама ничего не печатает: о поврежденном файле сообщает вызывающая функция
+bool loadOpeningBook(const string& fileName, vector<BookEntry>& book) {
+    book.clear();
+    ifstream file(fileName, ios::binary);
+    
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    char magic[6];
+    uint32_t count = 0;
+    if (!file.read(magic, 6) || string(magic, 6) != "QBOOK1" ||
+        !file.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+        return false;
+    }
+    
+    // Количество записей из заголовка должно совпадать с размером файла
+    file.seekg(0, ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(6 + sizeof(count), ios::beg);
+    if (fileSize - 6 - sizeof(count) != static_cast<uint64_t>(count) * sizeof(BookEntry)) {
+        return false;
+    }
+    
+    book.resize(count);
+    if (!file.read(reinterpret_cast<char*>(book.data()), count * sizeof(BookEntry))) {
+        book.clear();
+        return false;
+    }
+    
+    file.close();
+    return true;
+}
+
+// Найти ход в книге двоичным поиском; -1, если позиции нет или статистики мало
+int probeOpeningBook(const vector<BookEntry>& book, const QubicBoard& board) {
+    BookEntry key;
+    key.hash = board.hash;
+    key.move = 0;
+    vector<BookEntry>::const_iterator it = lower_bound(book.begin(), book.end(), key, bookEntryLess);
+    
+    int bestMove = -1;
+    uint32_t bestGames = 0;
+    uint32_t bestPoints = 0;
+    uint64_t occupied = board.pieces[0] | board.pieces[1];
+    for (; it != book.end() && it->hash == board.hash; ++it) {
+        if (it->games < BOOK_MIN_GAMES || (occupied & (1ULL << it->move))) continue;
+        
+        // Сравниваем средний результат без деления: points / games
+        uint64_t left = static_cast<uint64_t>(it->points) * bestGames;
+        uint64_t right = static_cast<uint64_t>(bestPoints) * it->games;
+        if (bestMove < 0 || left > right || (left == right && it->games > bestGames)) {
+            bestMove = it->move;
+            bestGames = it->games;
+            bestPoints = it->points;
+        }
+    }
+    return bestMove;
+}
+
+// Сыграть партии компьютера с самим собой и собрать статистику первых ходов.
+// Первые два хода - случайные клетки на 7 линиях (углы и центр куба),
+// чтобы партии не повторялись, а статистика не распылялась по слабым клеткам.
+vector<BookEntry> collectSelfPlayEntries(int games, int timeLimitMs) {
+    vector<BookEntry> entries;
+    QubicEngine engine = createQubicEngine();
+    
+    for (int game = 0; game < games; game++) {
+        QubicBoard board = createQubicBoard(PLAYER_X);
+        vector<BookEntry> gameEntries;
+        vector<int> movers;
+        
+        while (board.result == -1) {
+            int move;
+            int ply = __builtin_popcountll(board.pieces[0] | board.pieces[1]);
+            if (ply < 2) {
+                const QubicTables& tables = qubicTables();
+                do {
+                    move = rand() % QUBIC_CELLS;
+                } while (qubicCell(board, move) != EMPTY_CELL || tables.cellLines[move].size() != 7);
+            } else {
+                int depth = 0;
+                move = findQubicMove(engine, board, timeLimitMs, depth);
+            }
+            
+            if (ply < BOOK_PLIES) {
+                BookEntry entry = {board.hash, 1, 0, static_cast<uint8_t>(move), {0, 0, 0, 0, 0, 0, 0}};
+                gameEntries.push_back(entry);
+                movers.push_back(board.sideToMove);
+            }
+            applyQubicMove(board, move);
+        }
+        
+        // Очки каждого хода считаем по итогу партии для сходившего игрока
+        for (size_t i = 0; i < gameEntries.size(); i++) {
+            if (board.result == 2) gameEntries[i].points = 1;
+            else if (board.result == movers[i]) gameEntries[i].points = 2;
+            entries.push_back(gameEntries[i]);
+        }
+        
+        cout << "\rСыграно партий: " << (game + 1) << " из " << games << flush;
+    }
+    cout << "\n";
+    
+    compactBookEntries(entries);
+    return entries;
+}
+
+// Пополнить дебютную книгу партиями самоигры
+void buildOpeningBook() {
+    printHeader();
+    printColor("----ДЕБЮТНАЯ КНИГА QUBIC----\n", 33);
+    
+    vector<BookEntry> book;
+    // Поврежденную книгу не перезаписываем, иначе накопленная статистика пропадет
+    if (filesystem::exists(OPENING_BOOK_FILE) && !loadOpeningBook(OPENING_BOOK_FILE, book)) {
+        printColor("Ошибка: файл дебютной книги поврежден!\n", 31);
+        cout << "Исправьте или удалите файл " << OPENING_BOOK_FILE << " и попробуйте снова.\n";
+        waitForEnter();
+        return;
+    }
+    cout << "\nЗаписей в книге: " << book.size() << "\n";
+    
+    int games = getValidNumber("Сколько партий сыграть (1-1000): ", 1, 1000);
+    vector<BookEntry> fresh = collectSelfPlayEntries(games, BOOK_TIME_LIMIT_MS);
+    book = mergeBooks(book, fresh);
+    
+    if (saveOpeningBook(OPENING_BOOK_FILE, book)) {
+        printColor("Книга сохранена в файл: " + OPENING_BOOK_FILE + "\n", 32);
+        cout << "Записей в книге: " << book.size() << "\n";
+    }
+    waitForEnter();
+}
+
+// Вывод куба: четыре слоя рядом, в каждом те же координаты, что и в displayBoard
+void displayQubicBoard(const QubicBoard& board, int lastMove) {
+    cout << "\n";
+    for (int layer = 0; layer < QUBIC_SIZE; layer++) {
+        cout << "     Слой " << (layer + 1) << "         ";
+    }
+    cout << "\n";
+    for (int layer = 0; layer < QUBIC_SIZE; layer++) {
+        cout << "    1   2   3   4   ";  // Номера столбцов
+    }
+    cout << "\n";
+    
+    for (int row = 0; row < QUBIC_SIZE; row++) {
+        for (int layer = 0; layer < QUBIC_SIZE; layer++) {
+            cout << "  +---+---+---+---+ ";
+        }
+        cout << "\n";
+        
+        for (int layer = 0; layer < QUBIC_SIZE; layer++) {
+            cout << char('A' + row) << " | ";
+            for (int col = 0; col < QUBIC_SIZE; col++) {
+                int cell = layer * 16 + row * 4 + col;
+                char symbol = qubicCell(board, cell);
+                // Последний ход подсвечивается жирным
+                int style = (cell == lastMove) ? 1 : 0;
+                if (symbol == PLAYER_X) {
+                    printColor(string(1, symbol), style ? 91 : 31);  // Красный для X
+                } else if (symbol == PLAYER_O) {
+                    printColor(string(1, symbol), style ? 94 : 34);  // Синий для O
+                } else {
+                    cout << symbol;
+                }
+                cout << " | ";
+            }
+        }
+        cout << "\n";
+    }
+    for (int layer = 0; layer < QUBIC_SIZE; layer++) {
+        cout << "  +---+---+---+---+ ";
+    }
+    cout << "\n\n";
+}
+
+// Сохранить партию Qubic: текущий игрок, затем 4 слоя по 4 строки
+bool saveQubicGame(const QubicBoard& board) {
+    ofstream file(QUBIC_SAVE_FILE);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: не могу создать файл для сохранения!\n", 31);
+        return false;
+    }
+    
+    file << ((board.sideToMove == 0) ? PLAYER_X : PLAYER_O) << endl;
+    for (int layer = 0; layer < QUBIC_SIZE; layer++) {
+        for (int row = 0; row < QUBIC_SIZE; row++) {
+            for (int col = 0; col < QUBIC_SIZE; col++) {
+                file << qubicCell(board, layer * 16 + row * 4 + col);
+            }
+            file << endl;
+        }
+    }
+    
+    file.close();
+    return true;
+}
+
+// Загрузить партию Qubic из файла
+bool loadQubicGame(QubicBoard& board) {
+    ifstream file(QUBIC_SAVE_FILE);
+    
+    if (!file.is_open()) {
+        printColor("Ошибка: файл сохранения не найден!\n", 31);
+        return false;
+    }
+    
+    string line;
+    if (!getline(file, line) || (line != "X" && line != "O")) {
+        printColor("Ошибка: файл поврежден!\n", 31);
+        return false;
+    }
+    char currentPlayer = line[0];
+    
+    string cells;
+    for (int rowNum = 0; rowNum < QUBIC_SIZE * QUBIC_SIZE; rowNum++) {
+        if (!getline(file, line) || line.length() != static_cast<size_t>(QUBIC_SIZE)) {
+            printColor("Ошибка: неправильный формат поля в файле!\n", 31);
+            return false;
+        }
+        for (int col = 0; col < QUBIC_SIZE; col++) {
+            if (line[col] != PLAYER_X && line[col] != PLAYER_O && line[col] != EMPTY_CELL) {
+                printColor("Ошибка: неправильный символ в файле!\n", 31);
+                return false;
+            }
+        }
+        cells += line;
+    }
+    
+    file.close();
+    
+    // Законченную партию сохранить нельзя, но файл могли изменить вручную,
+    // поэтому итог заново определяется по линиям
+    board = qubicBoardFromCells(cells, currentPlayer);
+    return true;
+}
+
+// Правила Qubic
+void showQubicRules() {
+    printHeader();
+    printColor("----ПРАВИЛА QUBIC----\n", 33);
+    
+    cout << "\n1. Поле - куб 4x4x4 из четырех слоев 4x4\n";
+    cout << "2. Победит тот, кто первым поставит 4 символа в ряд:\n";
+    cout << "   в слое, по вертикали через слои или по диагонали куба\n";
+    cout << "   (всего 76 выигрышных линий)\n";
+    cout << "3. Ход: цифра слоя, буква строки и цифра столбца\n";
+    cout << "   Пример: ";
+    printColor("1A1", 32);
+    cout << ", ";
+    printColor("2B3", 32);
+    cout << ", ";
+    printColor("4D4\n", 32);
+    cout << "\n4. Команды: save - сохранить, menu - выйти, help - правила\n";
+    
+    waitForEnter();
+}
+
+// Игра в Qubic: два игрока или против компьютера
+void playQubic() {
+    printHeader();
+    printColor("----QUBIC 4x4x4----\n", 33);
+    cout << "\n1. Новая игра\n";
+    cout << "2. Загрузить сохраненную игру\n";
+    cout << "3. Пополнить дебютную книгу (игра компьютера с собой)\n";
+    int start = getValidNumber("Ваш выбор (1-3): ", 1, 3);
+    
+    if (start == 3) {
+        buildOpeningBook();
+        return;
+    }
+    
+    QubicBoard board = createQubicBoard(PLAYER_X);
+    if (start == 2 && !loadQubicGame(board)) {
+        waitForEnter();
+        return;
+    }
+    
+    cout << "\n1. Два игрока\n";
+    cout << "2. Против компьютера (вы играете за X)\n";
+    cout << "3. Против компьютера (вы играете за O)\n";
+    int mode = getValidNumber("Ваш выбор (1-3): ", 1, 3);
+    // Номер стороны компьютера: 0 - X, 1 - O, -1 - компьютер не играет
+    int computerSide = (mode == 2) ? 1 : ((mode == 3) ? 0 : -1);
+    
+    QubicEngine engine = createQubicEngine();
+    vector<BookEntry> book;
+    if (computerSide != -1 && filesystem::exists(OPENING_BOOK_FILE) && !loadOpeningBook(OPENING_BOOK_FILE, book)) {
+        printColor("Ошибка: файл дебютной книги поврежден! Компьютер играет без книги.\n", 31);
+        waitForEnter();
+    }
+    int moveCount = __builtin_popcountll(board.pieces[0] | board.pieces[1]);
+    int lastMove = -1;
+    // Запись партии начинается с текущей позиции: пустого куба или загруженной игры
+    Replay replay = createReplay(REPLAY_QUBIC, QUBIC_SIZE, qubicBoardCells(board),
+                                 (board.sideToMove == 0) ? PLAYER_X : PLAYER_O);
+    string lastComputerMove = "";
+    
+    while (board.result == -1) {
+        printHeader();
+        displayQubicBoard(board, lastMove);
+        
+        char currentPlayer = (board.sideToMove == 0) ? PLAYER_X : PLAYER_O;
+        if (!lastComputerMove.empty()) {
+            cout << lastComputerMove << "\n";
+        }
+        cout << "Ход #" << (moveCount + 1) << "\n";
+        cout << "Текущий игрок: ";
+        printColor(string(1, currentPlayer) + "\n", (currentPlayer == PLAYER_X) ? 31 : 34);
+        
+        int cell;
+        if (board.sideToMove == computerSide) {
+            int depth = 0;
+            chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+            // Позиция из дебютной книги разыгрывается без поиска
+            cell = probeOpeningBook(book, board);
+            bool fromBook = (cell >= 0);
+            if (!fromBook) {
+                cell = findQubicMove(engine, board, QUBIC_TIME_LIMIT_MS, depth);
+            }
+            long elapsed = static_cast<long>(chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - startTime).count());
+            
+            lastComputerMove = "Компьютер сходил " + to_string(cell / 16 + 1) +
+                               string(1, char('A' + cell % 16 / 4)) + to_string(cell % 4 + 1) +
+                               (fromBook ? " (из дебютной книги, " :
+                                           " (глубина " + to_string(depth) + ", ") + to_string(elapsed) + " мс)";
+        } else {
+            cout << "\nВведите ход (например, 2B3) или команду: ";
+            string input;
+            getline(cin, input);
+            input = trimString(input);
+            
+            if (input == "help" || input == "Help") {
+                showQubicRules();
+                continue;
+            }
+            
+            if (input == "menu" || input == "Menu") {
+                cout << "\nВыйти в главное меню? (да/нет): ";
+                string answer = getChoice("");
+                if (answer == "да") {
+                    storeReplay(replay);  // Недоигранная партия тоже попадает в архив
+                    return;
+                }
+                continue;
+            }
+            
+            if (input == "save" || input == "Save") {
+                if (saveQubicGame(board)) {
+                    printColor("Игра сохранена в файл: " + QUBIC_SAVE_FILE + "\n", 32);
+                }
+                waitForEnter();
+                continue;
+            }
+            
+            if (!isValidQubicMove(input, cell)) {
+                printColor("Ошибка: неправильный формат хода!\n", 31);
+                cout << "Используйте: 1A1, 2B3, 4D4 и т.д.\n";
+                waitForEnter();
+                continue;
+            }
+            
+            if (qubicCell(board, cell) != EMPTY_CELL) {
+                printColor("Ошибка: эта клетка уже занята!\n", 31);
+                waitForEnter();
+                continue;
+            }
+        }
+        
+        applyQubicMove(board, cell);
+        recordReplayMove(replay, cell);
+        lastMove = cell;
+        moveCount++;
+    }
+    
+    printHeader();
+    displayQubicBoard(board, lastMove);
+    if (!lastComputerMove.empty()) {
+        cout << lastComputerMove << "\n";
+    }
+    
+    cout << "\n";
+    printColor("----------------------------------------\n", 33);
+    if (board.result == 2) {
+        printColor("           НИЧЬЯ!\n", 34);
+    } else {
+        printColor("     ПОБЕДИЛ ИГРОК " + string(1, (board.result == 0) ? PLAYER_X : PLAYER_O) + "!\n", 32);
+    }
+    printColor("----------------------------------------\n", 33);
+    
+    cout << "\nВсего ходов: " << moveCount << endl;
+    storeReplay(replay);
+    waitForEnter();
+}
+
+// Параметры обратного решателя
+struct RetroSolver {
+    int size;                   // Сторона поля (3 или 4)
+    int cells;                  // Количество клеток
+    int winLength;              // Сколько символов подряд нужно для победы
+    vector<uint32_t> lines;     // Выигрышные линии в виде масок
+    string prefix;              // Начало имен файлов, например solver4x4_k3
+    uint64_t binomial[17][17];  // Биномиальные коэффициенты для нумерации позиций
+};
+
+// Подготовить решатель для поля size x size и линий длиной winLength
+RetroSolver createRetroSolver(int size, int winLength) {
+    RetroSolver solver;
+    solver.size = size;
+    solver.cells = size * size;
+    solver.winLength = winLength;
+    solver.lines = buildLineMasks(size, winLength);
+    solver.prefix = "solver" + to_string(size) + "x" + to_string(size) + "_k" + to_string(winLength);
+    
+    for (int n = 0; n <= SOLVER_MAX_CELLS; n++) {
+        for (int k = 0; k <= SOLVER_MAX_CELLS; k++) {
+            if (k == 0) solver.binomial[n][k] = 1;
+            else if (n == 0) solver.binomial[n][k] = 0;
+            else solver.binomial[n][k] = solver.binomial[n - 1][k - 1] + solver.binomial[n - 1][k];
+        }
+    }
+    return solver;
+}
+
+// Количество позиций с pieces фишками (X ходит первым, поэтому у X на одну фишку больше или поровну)
+uint64_t levelPositionCount(const RetroSolver& solver, int pieces) {
+    return solver.binomial[solver.cells][pieces] * solver.binomial[pieces][(pieces + 1) / 2];
+}
+
+// Номер подмножества в комбинаторной системе счисления
+uint64_t rankSubset(const RetroSolver& solver, uint32_t mask) {
+    uint64_t rank = 0;
+    int taken = 0;
+    for (int bit = 0; mask != 0; bit++, mask >>= 1) {
+        if (mask & 1) {
+            taken++;
+            rank += solver.binomial[bit][taken];
+        }
+    }
+    return rank;
+}
+
+// Подмножество из count элементов среди n по его номеру
+uint32_t unrankSubset(const RetroSolver& solver, uint64_t rank, int n, int count) {
+    uint32_t mask = 0;
+    for (int bit = n - 1; bit >= 0 && count > 0; bit--) {
+        if (solver.binomial[bit][count] <= rank) {
+            rank -= solver.binomial[bit][count];
+            mask |= 1u << bit;
+            count--;
+        }
+    }
+    return mask;
+}
+
+// Номер позиции внутри уровня: номер занятых клеток и номер клеток X среди занятых
+uint64_t rankPosition(const RetroSolver& solver, uint32_t xMask, uint32_t oMask) {
+    uint32_t occupied = xMask | oMask;
+    int pieces = __builtin_popcount(occupied);
+    
+    // Сжимаем маску X до номеров среди занятых клеток
+    uint32_t packedX = 0;
+    int index = 0;
+    for (int cell = 0; cell < solver.cells; cell++) {
+        if (occupied & (1u << cell)) {
+            if (xMask & (1u << cell)) packedX |= 1u << index;
+            index++;
         }
     }
     
-    cout << "  +---+---+---+\n\n";  // Нижняя граница
+    return rankSubset(solver, occupied) * solver.binomial[pieces][(pieces + 1) / 2] +
+           rankSubset(solver, packedX);
 }
 
-// Проверка, правильный ли формат хода
-bool isValidMove(const string& input, int& row, int& col) {
-    // Ход должен состоять из 2 символов: буква + цифра
-    if (input.length() != 2) return false;
-    
-    // Первый символ - буква строки (A, B, C)
-    char rowChar = toupper(input[0]);
-    // Второй символ - цифра столбца (1, 2, 3)
-    char colChar = input[1];
-    
-    // Проверяем допустимость буквы строки
-    if (rowChar < 'A' || rowChar > 'C') return false;
-    // Проверяем допустимость цифры столбца
-    if (colChar < '1' || colChar > '3') return false;
+// Восстановить позицию уровня pieces по ее номеру
+void unrankPosition(const RetroSolver& solver, uint64_t rank, int pieces, uint32_t& xMask, uint32_t& oMask) {
+    uint64_t xCount = solver.binomial[pieces][(pieces + 1) / 2];
+    uint32_t occupied = unrankSubset(solver, rank / xCount, solver.cells, pieces);
+    uint32_t packedX = unrankSubset(solver, rank % xCount, pieces, (pieces + 1) / 2);
+    
+    xMask = 0;
+    int index = 0;
+    for (int cell = 0; cell < solver.cells; cell++) {
+        if (occupied & (1u << cell)) {
+            if (packedX & (1u << index)) xMask |= 1u << cell;
+            index++;
+        }
+    }
+    oMask = occupied & ~xMask;
+}
+
+// Прочитать 2-битное значение позиции из упакованной таблицы
+int packedValue(const vector<uint8_t>& table, uint64_t index) {
+    return (table[index / 4] >> (index % 4 * 2)) & 3;
+}
+
+// Имя файла с результатами уровня
+string solverLevelFile(const RetroSolver& solver, int pieces) {
+    return solver.prefix + "_level" + (pieces < 10 ? "0" : "") + to_string(pieces) + ".bin";
+}
+
+// Прочитать уровень целиком в память (таблица уровня занимает не больше 0.5 МБ)
+bool loadSolverLevel(const RetroSolver& solver, int pieces, vector<uint8_t>& table) {
+    ifstream file(solverLevelFile(solver, pieces), ios::binary);
+    if (!file.is_open()) return false;
     
-    // Преобразуем символы в индексы массива:
-    // 'A' -> 0, 'B' -> 1, 'C' -> 2
-    // '1' -> 0, '2' -> 1, '3' -> 2
-    row = rowChar - 'A';
-    col = colChar - '1';
+    table.assign((levelPositionCount(solver, pieces) + 3) / 4, 0);
+    if (!file.read(reinterpret_cast<char*>(table.data()), table.size())) return false;
     
+    file.close();
     return true;
 }
 
-// Сделать ход на поле
-bool makeMove(GameBoard& board, int row, int col, char player) {
-    // Проверяем, что координаты в пределах поля
-    if (row < 0 || row >= BOARD_SIZE || 
-        col < 0 || col >= BOARD_SIZE) {
+// Решить часть уровня [begin, end): begin и end кратны 4, поэтому потоки пишут в разные байты
+void solveLevelRange(const RetroSolver& solver, int pieces, const vector<uint8_t>& next,
+                     vector<uint8_t>& out, uint64_t begin, uint64_t end) {
+    bool xToMove = (pieces % 2 == 0);
+    
+    for (uint64_t index = begin; index < end; index++) {
+        uint32_t xMask, oMask;
+        unrankPosition(solver, index, pieces, xMask, oMask);
+        uint32_t own = xToMove ? xMask : oMask;
+        uint32_t other = xToMove ? oMask : xMask;
+        
+        int value;
+        if (maskHasLine(other, solver.lines)) {
+            value = SOLVED_LOSS;  // Соперник уже собрал линию последним ходом
+        } else if (maskHasLine(own, solver.lines)) {
+            value = SOLVED_WIN;   // Недостижимая позиция, значение не влияет на ответ
+        } else if (pieces == solver.cells) {
+            value = SOLVED_DRAW;
+        } else {
+            // Значение позиции - лучший из ответов на каждый ход
+            value = SOLVED_LOSS;
+            uint32_t freeCells = ~(xMask | oMask) & ((1u << solver.cells) - 1);
+            for (int cell = 0; cell < solver.cells && value != SOLVED_WIN; cell++) {
+                if (!(freeCells & (1u << cell))) continue;
+                
+                uint64_t child = xToMove ? rankPosition(solver, xMask | (1u << cell), oMask)
+                                         : rankPosition(solver, xMask, oMask | (1u << cell));
+                int childValue = packedValue(next, child);
+                if (childValue == SOLVED_LOSS) value = SOLVED_WIN;
+                else if (childValue == SOLVED_DRAW) value = SOLVED_DRAW;
+            }
+        }
+        
+        out[index / 4] |= static_cast<uint8_t>(value << (index % 4 * 2));
+    }
+}
+
+// Решить один уровень по готовому следующему уровню и записать его на диск
+bool solveLevel(const RetroSolver& solver, int pieces) {
+    vector<uint8_t> next;
+    if (pieces < solver.cells && !loadSolverLevel(solver, pieces + 1, next)) {
+        printColor("Ошибка: не найден файл уровня " + to_string(pieces + 1) + "!\n", 31);
         return false;
     }
     
-    // Проверяем, что клетка пуста
-    if (board[row][col] != EMPTY_CELL) {
-        return false;
+    uint64_t count = levelPositionCount(solver, pieces);
+    vector<uint8_t> out((count + 3) / 4, 0);
+    
+    // Уровень делится на равные части по числу ядер процессора
+    unsigned threadCount = thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+    uint64_t part = ((count + threadCount - 1) / threadCount + 3) / 4 * 4;
+    vector<thread> workers;
+    for (unsigned t = 0; t < threadCount; t++) {
+        uint64_t begin = t * part;
+        uint64_t end = min(count, begin + part);
+        if (begin >= end) break;
+        workers.push_back(thread(solveLevelRange, cref(solver), pieces, cref(next), ref(out), begin, end));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
     }
     
-    // Ставим символ игрока в указанную клетку
-    board[row][col] = player;
+    // Пишем во временный файл блоками и переименовываем: оборванная запись не испортит уровень
+    string fileName = solverLevelFile(solver, pieces);
+    ofstream file(fileName + ".tmp", ios::binary);
+    if (!file.is_open()) {
+        printColor("Ошибка: не могу создать файл " + fileName + "!\n", 31);
+        return false;
+    }
+    for (size_t offset = 0; offset < out.size(); offset += SOLVER_CHUNK_BYTES) {
+        size_t length = min(static_cast<size_t>(SOLVER_CHUNK_BYTES), out.size() - offset);
+        file.write(reinterpret_cast<const char*>(out.data() + offset), length);
+    }
+    file.close();
+    if (!file || rename((fileName + ".tmp").c_str(), fileName.c_str()) != 0) {
+        printColor("Ошибка: не удалось записать " + fileName + "!\n", 31);
+        return false;
+    }
     return true;
 }
 
-// Проверка, есть ли победитель
-char checkWinner(const GameBoard& board) {
-    // Проверка строк: все три клетки в строке должны быть одинаковы и не пусты
-    for (int row = 0; row < BOARD_SIZE; row++) {
-        if (board[row][0] != EMPTY_CELL && 
-            board[row][0] == board[row][1] && 
-            board[row][1] == board[row][2]) {
-            return board[row][0];  // Возвращаем символ победителя
-        }
+// Прочитать контрольную точку: наименьший уже решенный уровень (cells + 1 - ничего не решено)
+int readSolverCheckpoint(const RetroSolver& solver) {
+    ifstream file(solver.prefix + ".chk");
+    int level = solver.cells + 1;
+    if (!file.is_open() || !(file >> level) || level < 0 || level > solver.cells + 1) {
+        return solver.cells + 1;
     }
     
-    // Проверка столбцов: все три клетки в столбце должны быть одинаковы и не пусты
-    for (int col = 0; col < BOARD_SIZE; col++) {
-        if (board[0][col] != EMPTY_CELL && 
-            board[0][col] == board[1][col] && 
-            board[1][col] == board[2][col]) {
-            return board[0][col];
-        }
+    // Проверяем, что файлы всех решенных уровней на месте
+    for (int pieces = level; pieces <= solver.cells; pieces++) {
+        ifstream levelFile(solverLevelFile(solver, pieces), ios::binary);
+        if (!levelFile.is_open()) return solver.cells + 1;
     }
-    
-    // Проверка главной диагонали (слева сверху направо вниз)
-    if (board[0][0] != EMPTY_CELL && 
-        board[0][0] == board[1][1] && 
-        board[1][1] == board[2][2]) {
-        return board[0][0];
+    return level;
+}
+
+// Записать контрольную точку после завершения уровня
+bool writeSolverCheckpoint(const RetroSolver& solver, int level) {
+    ofstream file(solver.prefix + ".chk");
+    if (!file.is_open()) return false;
+    file << level << endl;
+    file.close();
+    return true;
+}
+
+// Решить все уровни от полного поля к пустому, продолжая с контрольной точки
+bool runRetroSolver(const RetroSolver& solver, bool showProgress) {
+    int level = readSolverCheckpoint(solver);
+    if (showProgress && level <= solver.cells) {
+        cout << "Продолжение с контрольной точки: уровни " << level << "-" << solver.cells << " уже решены\n";
     }
     
-    // Проверка побочной диагонали (справа сверху налево вниз)
-    if (board[0][2] != EMPTY_CELL && 
-        board[0][2] == board[1][1] && 
-        board[1][1] == board[2][0]) {
-        return board[0][2];
+    for (int pieces = level - 1; pieces >= 0; pieces--) {
+        if (showProgress) {
+            cout << "Уровень " << pieces << " (" << levelPositionCount(solver, pieces) << " позиций)... " << flush;
+        }
+        if (!solveLevel(solver, pieces) || !writeSolverCheckpoint(solver, pieces)) {
+            return false;
+        }
+        if (showProgress) {
+            printColor("готово\n", 32);
+        }
     }
-    
-    // Если ни одна из проверок не прошла - победителя нет
-    return EMPTY_CELL;
+    return true;
 }
 
-// Проверка, заполнено ли всё поле (ничья)
-bool isDraw(const GameBoard& board) {
-    // Проходим по всем клеткам поля
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            // Если найдена хоть одна пустая клетка - это не ничья
-            if (board[i][j] == EMPTY_CELL) {
-                return false;
-            }
-        }
+// Значение позиции для игрока, который ходит (по решенным файлам уровней)
+int lookupSolvedValue(const RetroSolver& solver, uint32_t xMask, uint32_t oMask) {
+    vector<uint8_t> table;
+    if (!loadSolverLevel(solver, __builtin_popcount(xMask | oMask), table)) return SOLVED_UNKNOWN;
+    return packedValue(table, rankPosition(solver, xMask, oMask));
+}
+
+// Удалить файлы решателя (уровни и контрольную точку)
+void removeSolverFiles(const RetroSolver& solver) {
+    for (int pieces = 0; pieces <= solver.cells; pieces++) {
+        remove(solverLevelFile(solver, pieces).c_str());
     }
-    // Если все клетки заполнены - ничья
-    return true;
+    remove((solver.prefix + ".chk").c_str());
 }
 
-// Сохранить игру в файл
-bool saveGame(const GameBoard& board, char currentPlayer) {
-    // Открываем файл для записи
-    ofstream file(SAVE_FILE);
+// Название значения позиции
+string solvedValueName(int value) {
+    if (value == SOLVED_WIN) return "победа";
+    if (value == SOLVED_DRAW) return "ничья";
+    if (value == SOLVED_LOSS) return "поражение";
+    return "неизвестно";
+}
+
+// Меню решателя: решить поле 3x3 или 4x4 и показать оценки первых ходов
+void showRetroSolver() {
+    printHeader();
+    printColor("----РЕШАТЕЛЬ ПОЛЕЙ 4x4----\n", 33);
+    cout << "\n1. Поле 4x4, нужно собрать 4 в ряд\n";
+    cout << "2. Поле 4x4, нужно собрать 3 в ряд\n";
+    cout << "3. Поле 3x3 (классические правила)\n";
+    int choice = getValidNumber("Ваш выбор (1-3): ", 1, 3);
     
-    if (!file.is_open()) {
-        printColor("Ошибка: не могу создать файл для сохранения!\n", 31);
-        return false;
-    }
+    int size = (choice == 3) ? 3 : 4;
+    int winLength = (choice == 1) ? 4 : 3;
+    RetroSolver solver = createRetroSolver(size, winLength);
     
-    // Сохраняем текущего игрока (чей ход)
-    file << currentPlayer << endl;
+    cout << "\nЛиний на поле: " << solver.lines.size() << "\n";
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!runRetroSolver(solver, true)) {
+        waitForEnter();
+        return;
+    }
+    long elapsed = static_cast<long>(chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - start).count());
+    cout << "Время: " << elapsed << " мс\n";
+    
+    cout << "\nПустое поле, ходит X: ";
+    printColor(solvedValueName(lookupSolvedValue(solver, 0, 0)) + "\n", 32);
+    
+    // Оценки первых ходов X: значение для X - обратное значению для O после хода
+    GameBoard board = createEmptyBoard(size);
+    cout << "\nПервые ходы X (W - победа, D - ничья, L - поражение):";
+    for (int cell = 0; cell < solver.cells; cell++) {
+        int reply = lookupSolvedValue(solver, 1u << cell, 0);
+        board[cell / size][cell % size] = (reply == SOLVED_LOSS) ? 'W' : ((reply == SOLVED_DRAW) ? 'D' : 'L');
+    }
+    displayBoard(board);
     
-    // Сохраняем игровое поле: каждая строка поля - отдельная строка в файле
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            file << board[i][j];  // Записываем символ клетки
-        }
-        file << endl;  // Переход на новую строку после каждой строки поля
+    waitForEnter();
+}
+
+// Показать позицию из записи так же, как во время игры в ее режиме; в конце партии - итог
+void displayReplayPosition(const Replay& replay, const string& cells, int ply) {
+    int totalMoves = replay.moves.size();
+    int lastMove = (ply > 0) ? replay.moves[ply - 1] : -1;
+    char playerToMove = (ply % 2 == 0) ? replay.firstPlayer :
+                        ((replay.firstPlayer == PLAYER_X) ? PLAYER_O : PLAYER_X);
+    int result = -1;  // -1 - игра идет, 0 - победил X, 1 - победил O, 2 - ничья
+    
+    if (replay.game == REPLAY_ULTIMATE) {
+        UltimateBoard board = ultimateBoardFromCells(cells, lastMove, playerToMove);
+        displayUltimateBoard(board);
+        result = board.result;
+    } else if (replay.game == REPLAY_QUBIC) {
+        QubicBoard board = qubicBoardFromCells(cells, playerToMove);
+        displayQubicBoard(board, lastMove);
+        result = board.result;
+    } else {
+        GameBoard board = cellsToBoard(cells, replay.size);
+        displayBoard(board);
+        char winner = checkWinner(board);
+        if (winner != EMPTY_CELL) result = (winner == PLAYER_X) ? 0 : 1;
+        else if (isDraw(board)) result = 2;
     }
     
-    file.close();
-    return true;
+    cout << "Ход " << ply << " из " << totalMoves;
+    if (lastMove >= 0) {
+        cout << " (последний ход: " << replayMoveName(replay, lastMove) << ")";
+    }
+    cout << "\n";
+    if (ply == totalMoves && result == 2) {
+        printColor("Ничья\n", 34);
+    } else if (ply == totalMoves && result != -1) {
+        printColor("Победил игрок " + string(1, (result == 0) ? PLAYER_X : PLAYER_O) + "\n", 32);
+    }
 }
 
-// Загрузить игру из файла
-bool loadGame(GameBoard& board, char& currentPlayer) {
-    // Открываем файл для чтения
-    ifstream file(SAVE_FILE);
+// Просмотр записи партии: шаги вперед и назад, переход к ходу и автовоспроизведение
+void viewReplay() {
+    printHeader();
+    printColor("----ПРОСМОТР ЗАПИСИ ПАРТИИ----\n", 33);
     
-    if (!file.is_open()) {
-        printColor("Ошибка: файл сохранения не найден!\n", 31);
-        return false;
+    vector<string> files = listReplayFiles();
+    if (files.empty()) {
+        cout << "\nЗаписей партий пока нет. Они появляются после каждой партии.\n";
+        waitForEnter();
+        return;
     }
     
-    string line;
-    // Читаем первую строку - символ текущего игрока
-    if (!getline(file, line) || line.empty()) {
-        printColor("Ошибка: файл поврежден!\n", 31);
-        return false;
+    cout << "\n";
+    for (size_t i = 0; i < files.size(); i++) {
+        cout << (i + 1) << ". " << files[i] << "\n";
     }
-    currentPlayer = line[0];
+    int fileCount = files.size();
+    int fileNumber = getValidNumber("Выберите запись (1-" + to_string(fileCount) + "): ", 1, fileCount);
     
-    int rowNum = 0;
-    // Читаем следующие 3 строки - игровое поле
-    while (getline(file, line) && rowNum < BOARD_SIZE) {
-        // Проверяем, что строка имеет правильную длину
-        if (line.length() != BOARD_SIZE) {
-            printColor("Ошибка: неправильный формат поля в файле!\n", 31);
-            return false;
-        }
-        
-        // Копируем символы из строки в игровое поле
-        for (int col = 0; col < BOARD_SIZE; col++) {
-            board[rowNum][col] = line[col];
-        }
-        rowNum++;
+    Replay replay;
+    if (!loadReplay(files[fileNumber - 1], replay)) {
+        printColor("Ошибка: файл записи партии поврежден!\n", 31);
+        waitForEnter();
+        return;
     }
     
-    file.close();
+    int totalMoves = replay.moves.size();
+    int ply = 0;
+    int delayMs = 800;  // Пауза между ходами при воспроизведении
     
-    // Проверяем, что загружено полное поле (3 строки)
-    if (rowNum != BOARD_SIZE) {
-        printColor("Ошибка: неполное поле в файле!\n", 31);
-        return false;
+    while (true) {
+        int appliedMoves = 0;
+        string cells = positionAtPly(replay, ply, appliedMoves);
+        
+        printHeader();
+        printColor("----ПРОСМОТР ЗАПИСИ ПАРТИИ----\n", 33);
+        displayReplayPosition(replay, cells, ply);
+        
+        cout << "\nКоманды: n - вперед, p - назад, g <номер> - к ходу,\n";
+        cout << "play - воспроизвести, speed <мс> - пауза (сейчас " << delayMs << "), menu - выход\n";
+        cout << "Команда: ";
+        string input;
+        if (!getline(cin, input)) return;
+        input = toLowerCase(trimString(input));
+        
+        if (input == "menu") {
+            return;
+        } else if (input == "n" || input.empty()) {
+            if (ply < totalMoves) ply++;
+        } else if (input == "p") {
+            if (ply > 0) ply--;
+        } else if (input == "play") {
+            // Каждый шаг - один ход от текущего поля, без повторного поиска снимка
+            while (ply < totalMoves) {
+                this_thread::sleep_for(chrono::milliseconds(delayMs));
+                applyReplayMove(replay, cells, ply);
+                ply++;
+                printHeader();
+                printColor("----ПРОСМОТР ЗАПИСИ ПАРТИИ----\n", 33);
+                displayReplayPosition(replay, cells, ply);
+            }
+        } else if (input.compare(0, 2, "g ") == 0 || input.compare(0, 6, "speed ") == 0) {
+            bool isJump = (input[0] == 'g');
+            string number = trimString(input.substr(isJump ? 2 : 6));
+            char* endPtr;
+            long value = strtol(number.c_str(), &endPtr, 10);
+            int maxValue = isJump ? totalMoves : 5000;
+            int minValue = isJump ? 0 : 50;
+            if (number.empty() || *endPtr != '\0' || value < minValue || value > maxValue) {
+                printColor("Ошибка: число должно быть от " + to_string(minValue) + " до " +
+                           to_string(maxValue) + "!\n", 31);
+                waitForEnter();
+            } else if (isJump) {
+                ply = value;
+            } else {
+                delayMs = value;
+            }
+        } else {
+            printColor("Ошибка: неизвестная команда!\n", 31);
+            waitForEnter();
+        }
     }
-    
-    return true;
 }
 
 // Запуск тестов программы
@@ -379,7 +3025,7 @@ void runTests() {
     printColor("----ТЕСТИРОВАНИЕ ПРОГРАММЫ----\n", 33);
     
     int passedTests = 0;
-    int totalTests = 8;
+    int totalTests = 19;
     
     cout << "\nТест 1: Создание пустого поля... ";
     GameBoard testBoard = createEmptyBoard();
@@ -485,6 +3131,279 @@ void runTests() {
         printColor("ПРОВАЛ ✗\n", 31);
     }
     
+    cout << "Тест 9: Кодирование порядка ходов... ";
+    // Партия должна восстанавливаться из номера перестановки без потерь
+    vector<int> testMoves;
+    testMoves.push_back(4); testMoves.push_back(0); testMoves.push_back(2);
+    testMoves.push_back(8); testMoves.push_back(6);
+    uint32_t testCode = encodeMoveOrder(testMoves);
+    vector<int> decodedMoves = decodeMoveOrder(testCode);
+    char codeWinner;
+    int codeLength = replayGameCode(testCode, codeWinner, NULL);
+    if (testCode < (1u << GAME_CODE_BITS) &&
+        equal(testMoves.begin(), testMoves.end(), decodedMoves.begin()) &&
+        codeLength == 5 && codeWinner == PLAYER_X) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 10: База всех партий... ";
+    // Известные значения: 255168 партий, из них 1440 побед X за 5 ходов
+    GameDatabase testDatabase;
+    GameBoard enumBoard = createEmptyBoard();
+    vector<int> enumMoves;
+    enumerateGames(enumBoard, enumMoves, PLAYER_X, testDatabase.codes);
+    buildDatabaseIndexes(testDatabase);
+    if (testDatabase.codes.size() == TOTAL_GAMES &&
+        countGamesWithResult(testDatabase, PLAYER_X, 5) == 1440 &&
+        countGamesWithResult(testDatabase, EMPTY_CELL, 9) == 46080 &&
+        countGamesThrough(testDatabase, createEmptyBoard(), PLAYER_X) == 255168) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 11: Ходы Ultimate... ";
+    // Ход в E6 (центральное поле, правая средняя клетка) отправляет соперника в поле 5
+    UltimateBoard ultimateBoard = createUltimateBoard(PLAYER_X);
+    int ultimateMoves[81];
+    int firstCount = generateUltimateMoves(ultimateBoard, ultimateMoves);
+    bool centerMoveOK = isValidMove("E6", row, col, ULTIMATE_SIZE);
+    if (centerMoveOK) {
+        applyUltimateMove(ultimateBoard, ultimateMoveFromCoords(row, col));
+    }
+    int replyCount = generateUltimateMoves(ultimateBoard, ultimateMoves);
+    bool repliesInSub5 = true;
+    for (int i = 0; i < replyCount; i++) {
+        if (ultimateMoves[i] / 9 != 5) repliesInSub5 = false;
+    }
+    if (centerMoveOK && firstCount == 81 && replyCount == 9 && repliesInSub5 &&
+        ultimateBoard.nextSubBoard == 5 && !isValidMove("J1", row, col, ULTIMATE_SIZE)) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 12: Победа в Ultimate... ";
+    // X уже выиграл малые поля 0 и 1 и может закрыть верхнюю строку большого поля
+    UltimateBoard nearWin = createUltimateBoard(PLAYER_X);
+    nearWin.won[0] = 0x003;
+    nearWin.closed = 0x003;
+    nearWin.cells[0][0] = 0x007;
+    nearWin.cells[0][1] = 0x007;
+    nearWin.cells[0][2] = 0x003;
+    nearWin.nextSubBoard = 2;
+    int searchDepth = 0;
+    int winningMove = findUltimateMove(nearWin, ULTIMATE_TIME_LIMIT_MS, searchDepth);
+    applyUltimateMove(nearWin, winningMove);
+    if (winningMove == 2 * 9 + 2 && nearWin.result == 0 && (nearWin.won[0] & 0x004)) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 13: Линии куба Qubic... ";
+    // 76 линий; через угол и центральные клетки проходят 7 линий, через остальные - 4
+    const QubicTables& testTables = qubicTables();
+    int qubicCellIndex = -1;
+    bool qubicInputOK = isValidQubicMove("4D4", qubicCellIndex) && qubicCellIndex == 63 &&
+                        !isValidQubicMove("5A1", qubicCellIndex) && !isValidQubicMove("1E1", qubicCellIndex);
+    if (testTables.lines.size() == 76 && testTables.cellLines[0].size() == 7 &&
+        testTables.cellLines[21].size() == 7 && testTables.cellLines[1].size() == 4 && qubicInputOK) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 14: Победа и защита в Qubic... ";
+    // O угрожает собрать вертикаль через слои, X должен ее закрыть; затем X выигрывает диагональ куба
+    QubicBoard qubicBoard = createQubicBoard(PLAYER_X);
+    qubicBoard.pieces[1] = (1ULL << 5) | (1ULL << 21) | (1ULL << 37);
+    qubicBoard.pieces[0] = (1ULL << 0) | (1ULL << 3) | (1ULL << 12);
+    QubicEngine testEngine = createQubicEngine();
+    int qubicDepth = 0;
+    int blockMove = findQubicMove(testEngine, qubicBoard, 200, qubicDepth);
+    QubicBoard diagonal = createQubicBoard(PLAYER_X);
+    diagonal.pieces[0] = (1ULL << 0) | (1ULL << 21) | (1ULL << 42);
+    diagonal.pieces[1] = (1ULL << 1) | (1ULL << 2) | (1ULL << 3);
+    int winMove = findQubicMove(testEngine, diagonal, 200, qubicDepth);
+    applyQubicMove(diagonal, winMove);
+    if (blockMove == 53 && winMove == 63 && diagonal.result == 0) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 15: Поля 4x4 и нумерация позиций... ";
+    // 4 в ряд на 4x4 - 10 линий, 3 в ряд - 24; номер позиции восстанавливается обратно
+    RetroSolver rankSolver = createRetroSolver(4, 3);
+    GameBoard bigBoard = createEmptyBoard(4);
+    bigBoard[1][3] = PLAYER_O; bigBoard[2][2] = PLAYER_O; bigBoard[3][1] = PLAYER_O;
+    uint32_t rankX = (1u << 0) | (1u << 5) | (1u << 9) | (1u << 15);
+    uint32_t rankO = (1u << 7) | (1u << 10) | (1u << 13);
+    uint32_t backX = 0, backO = 0;
+    unrankPosition(rankSolver, rankPosition(rankSolver, rankX, rankO), 7, backX, backO);
+    if (buildLineMasks(4, 4).size() == 10 && rankSolver.lines.size() == 24 &&
+        buildLineMasks(3, 3).size() == 8 && maskHasLine(rankO, rankSolver.lines) &&
+        checkWinner(bigBoard, 3) == PLAYER_O && checkWinner(bigBoard, 4) == EMPTY_CELL &&
+        backX == rankX && backO == rankO) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 16: Обратный решатель 3x3... ";
+    // Классическое поле - ничья; после X в A1 и O в A2 у X выигрыш
+    RetroSolver testSolver = createRetroSolver(3, 3);
+    testSolver.prefix = "test_" + testSolver.prefix;  // Не трогаем файлы настоящего решателя
+    removeSolverFiles(testSolver);
+    bool solved = runRetroSolver(testSolver, false);
+    int emptyValue = lookupSolvedValue(testSolver, 0, 0);
+    int afterA2Value = lookupSolvedValue(testSolver, 1u << 0, 1u << 1);
+    removeSolverFiles(testSolver);
+    if (solved && emptyValue == SOLVED_DRAW && afterA2Value == SOLVED_WIN) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 17: Дебютная книга... ";
+    // Две книги сливаются с суммированием статистики и находятся двоичным поиском
+    QubicBoard bookBoard = createQubicBoard(PLAYER_X);
+    QubicBoard afterCorner = bookBoard;
+    applyQubicMove(afterCorner, 0);
+    vector<BookEntry> oldBook;
+    vector<BookEntry> newBook;
+    BookEntry cornerEntry = {bookBoard.hash, 1, 2, 0, {0, 0, 0, 0, 0, 0, 0}};
+    BookEntry centerEntry = {bookBoard.hash, 3, 3, 21, {0, 0, 0, 0, 0, 0, 0}};
+    BookEntry replyEntry = {afterCorner.hash, 1, 2, 63, {0, 0, 0, 0, 0, 0, 0}};
+    oldBook.push_back(centerEntry);
+    oldBook.push_back(cornerEntry);
+    newBook.push_back(cornerEntry);
+    newBook.push_back(replyEntry);
+    compactBookEntries(oldBook);
+    compactBookEntries(newBook);
+    vector<BookEntry> testBook = mergeBooks(oldBook, newBook);
+    saveOpeningBook("test_" + OPENING_BOOK_FILE, testBook);
+    vector<BookEntry> loadedBook;
+    bool bookLoaded = loadOpeningBook("test_" + OPENING_BOOK_FILE, loadedBook);
+    // Заголовок обещает больше записей, чем есть в файле - книга отвергается
+    ofstream brokenBook(("test_" + OPENING_BOOK_FILE).c_str(), ios::binary);
+    uint32_t brokenCount = 0xFFFFFFFF;
+    brokenBook.write("QBOOK1", 6);
+    brokenBook.write(reinterpret_cast<const char*>(&brokenCount), sizeof(brokenCount));
+    brokenBook.close();
+    vector<BookEntry> brokenEntries;
+    bool brokenRejected = !loadOpeningBook("test_" + OPENING_BOOK_FILE, brokenEntries) && brokenEntries.empty();
+    remove(("test_" + OPENING_BOOK_FILE).c_str());
+    // Угол: 2 партии, 4 очка - лучше центра (3 партии, 3 очка); ответ сыгран один раз - мало
+    if (bookLoaded && brokenRejected && loadedBook.size() == 3 && probeOpeningBook(loadedBook, bookBoard) == 0 &&
+        probeOpeningBook(loadedBook, afterCorner) == -1) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 18: Анализ клеток и кэш оценок... ";
+    // X: A1, B2; O: A2. Ход X в C3 выигрывает сразу, пустое поле - ничья,
+    // повторный анализ той же позиции берется из кэша
+    GameBoard hintBoard = createEmptyBoard();
+    hintBoard[0][0] = PLAYER_X; hintBoard[1][1] = PLAYER_X; hintBoard[0][1] = PLAYER_O;
+    AnalysisCache& testCache = analysisCache();
+    int winNow = evaluateCellMove(hintBoard, 2, 2, PLAYER_X);
+    GameBoard emptyHintBoard = createEmptyBoard();
+    int emptyValue3x3 = solvePosition(emptyHintBoard, PLAYER_X);
+    long hitsBefore = testCache.hits;
+    solvePosition(emptyHintBoard, PLAYER_X);
+    if (winNow == ANALYSIS_WIN - 1 && emptyValue3x3 == 0 && testCache.hits == hitsBefore + 1 &&
+        testCache.recent.size() <= testCache.capacity && hintBoard[2][2] == EMPTY_CELL) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
+    cout << "Тест 19: Запись партии и переход к ходу... ";
+    // O начинает: A1, B2, A2, C3, A3 (победа O); после сохранения и загрузки
+    // поле на 3-м ходу собирается из снимка 0, на 5-м - из снимка 4 и одного хода
+    Replay testReplay = createReplay(REPLAY_CLASSIC, BOARD_SIZE, boardCells(createEmptyBoard()), PLAYER_O);
+    GameBoard replayBoard = createEmptyBoard();
+    const int replayMoves[5][2] = {{0, 0}, {1, 1}, {0, 1}, {2, 2}, {0, 2}};
+    char replayPlayer = PLAYER_O;
+    for (int i = 0; i < 5; i++) {
+        makeMove(replayBoard, replayMoves[i][0], replayMoves[i][1], replayPlayer);
+        recordReplayMove(testReplay, replayMoves[i][0] * BOARD_SIZE + replayMoves[i][1]);
+        replayPlayer = (replayPlayer == PLAYER_X) ? PLAYER_O : PLAYER_X;
+    }
+    saveReplay("test" + REPLAY_EXTENSION, testReplay);
+    Replay loadedReplay;
+    bool replayLoaded = loadReplay("test" + REPLAY_EXTENSION, loadedReplay);
+    remove(("test" + REPLAY_EXTENSION).c_str());
+    int appliedAt3 = -1, appliedAt5 = -1;
+    GameBoard at3 = createEmptyBoard();
+    GameBoard at5 = createEmptyBoard();
+    if (replayLoaded) {
+        at3 = cellsToBoard(positionAtPly(loadedReplay, 3, appliedAt3), BOARD_SIZE);
+        at5 = cellsToBoard(positionAtPly(loadedReplay, 5, appliedAt5), BOARD_SIZE);
+    }
+    // Запись продолжения загруженной игры начинается с ее позиции
+    GameBoard resumedStart = createEmptyBoard();
+    resumedStart[1][1] = PLAYER_X;
+    Replay resumedReplay = createReplay(REPLAY_CLASSIC, BOARD_SIZE, boardCells(resumedStart), PLAYER_O);
+    int appliedResumed = -1;
+    bool resumedOK = positionAtPly(resumedReplay, 0, appliedResumed) == boardCells(resumedStart) && appliedResumed == 0;
+    // Qubic: X собирает строку A первого слоя за 7 ходов; ход 1A4 собирается из снимка 4 и трех ходов
+    Replay qubicReplay = createReplay(REPLAY_QUBIC, QUBIC_SIZE, string(QUBIC_CELLS, EMPTY_CELL), PLAYER_X);
+    const int qubicReplayMoves[7] = {0, 16, 1, 17, 2, 18, 3};
+    for (int i = 0; i < 7; i++) {
+        recordReplayMove(qubicReplay, qubicReplayMoves[i]);
+    }
+    saveReplay("test" + REPLAY_EXTENSION, qubicReplay);
+    Replay loadedQubic;
+    bool qubicLoaded = loadReplay("test" + REPLAY_EXTENSION, loadedQubic);
+    remove(("test" + REPLAY_EXTENSION).c_str());
+    int appliedQubic = -1;
+    bool qubicOK = qubicLoaded && loadedQubic.game == REPLAY_QUBIC && replayMoveName(loadedQubic, 3) == "1A4" &&
+                   qubicBoardFromCells(positionAtPly(loadedQubic, 7, appliedQubic), PLAYER_O).result == 0 &&
+                   appliedQubic == 3;
+    // Ход в занятую клетку и снимок, который не получается из ходов, делают файл негодным
+    Replay brokenReplay;
+    ofstream brokenFile("test" + REPLAY_EXTENSION);
+    brokenFile << "REPLAY 2\nclassic 3 4 X 2 1\n00000\nA1\nA1\n";
+    brokenFile.close();
+    bool overwriteRejected = !loadReplay("test" + REPLAY_EXTENSION, brokenReplay);
+    brokenFile.open("test" + REPLAY_EXTENSION);
+    brokenFile << "REPLAY 2\nclassic 3 4 X 4 2\n00000\n00000\nA1\nB2\nA2\nC3\n";
+    brokenFile.close();
+    bool snapshotRejected = !loadReplay("test" + REPLAY_EXTENSION, brokenReplay);
+    remove(("test" + REPLAY_EXTENSION).c_str());
+    // Ultimate: после E5 (центр центрального поля) O обязан ходить в центральное малое поле
+    Replay ultimateReplay = createReplay(REPLAY_ULTIMATE, ULTIMATE_SIZE,
+                                         string(ULTIMATE_SIZE * ULTIMATE_SIZE, EMPTY_CELL), PLAYER_X);
+    recordReplayMove(ultimateReplay, 4 * ULTIMATE_SIZE + 4);
+    UltimateBoard ultimateAt1 = ultimateBoardFromCells(ultimateReplay.position, ultimateReplay.moves[0], PLAYER_O);
+    bool ultimateOK = ultimateAt1.nextSubBoard == 4 && ultimateAt1.sideToMove == 1 &&
+                      ultimateCell(ultimateAt1, 4, 4) == PLAYER_X && replayMoveName(ultimateReplay, 40) == "E5";
+    if (replayLoaded && resumedOK && qubicOK && ultimateOK && overwriteRejected && snapshotRejected &&
+        loadedReplay.snapshots.size() == 2 &&
+        appliedAt3 == 3 && appliedAt5 == 1 && at3[0][1] == PLAYER_O && at3[2][2] == EMPTY_CELL && at5 == replayBoard &&
+        checkWinner(at5) == PLAYER_O) {
+        printColor("ПРОЙДЕН ✓\n", 32);
+        passedTests++;
+    } else {
+        printColor("ПРОВАЛ ✗\n", 31);
+    }
+    
     cout << "\n----------------------------------------\n";
     cout << "РЕЗУЛЬТАТ: " << passedTests << " из " << totalTests << " тестов пройдены\n";
     
@@ -539,6 +3458,11 @@ void showRules() {
     cout << "   - ";
     printColor("help", 32);
     cout << " - показать правила\n";
+    cout << "   - ";
+    printColor("hint", 32);
+    cout << " или ";
+    printColor("analyze", 32);
+    cout << " - оценить каждую свободную клетку\n";
     
     waitForEnter();
 }
@@ -573,6 +3497,9 @@ void playGame() {
         waitForEnter();
     }
     
+    // Запись партии для последующего просмотра
+    Replay replay = createReplay(REPLAY_CLASSIC, BOARD_SIZE, boardCells(board), currentPlayer);
+    
     // Основной игровой цикл
     while (!gameOver) {
         printHeader();
@@ -601,6 +3528,7 @@ void playGame() {
             cout << "\nВыйти в главное меню? (да/нет): ";
             string answer = getChoice("");
             if (answer == "да") {
+                storeReplay(replay);  // Недоигранная партия тоже попадает в архив
                 return;
             }
             continue;
@@ -614,6 +3542,12 @@ void playGame() {
             continue;
         }
         
+        if (input == "hint" || input == "Hint" || input == "analyze" || input == "Analyze") {
+            showAnalysis(board, currentPlayer);
+            waitForEnter();
+            continue;
+        }
+        
         // Проверка правильности хода
         int row, col;
         if (!isValidMove(input, row, col)) {
@@ -631,6 +3565,7 @@ void playGame() {
         }
         
         moveCount++;
+        recordReplayMove(replay, row * BOARD_SIZE + col);
         
         // Проверяем, не закончилась ли игра
         char winner = checkWinner(board);
@@ -661,6 +3596,7 @@ void playGame() {
     }
     
     cout << "\nВсего ходов: " << moveCount << endl;
+    storeReplay(replay);
     waitForEnter();
 }
 
@@ -695,6 +3631,9 @@ void loadSavedGame() {
         }
     }
     
+    // Запись продолжения начинается с загруженной позиции
+    Replay replay = createReplay(REPLAY_CLASSIC, BOARD_SIZE, boardCells(board), currentPlayer);
+    
     while (!gameOver) {
         printHeader();
         displayBoard(board);
@@ -708,6 +3647,7 @@ void loadSavedGame() {
         input = trimString(input);
         
         if (input == "menu" || input == "Menu") {
+            storeReplay(replay);
             return;
         }
         
@@ -717,6 +3657,12 @@ void loadSavedGame() {
             continue;
         }
         
+        if (input == "hint" || input == "Hint" || input == "analyze" || input == "Analyze") {
+            showAnalysis(board, currentPlayer);
+            waitForEnter();
+            continue;
+        }
+        
         int row, col;
         if (!isValidMove(input, row, col)) {
             printColor("Ошибка: неправильный формат!\n", 31);
@@ -731,6 +3677,7 @@ void loadSavedGame() {
         }
         
         moveCount++;
+        recordReplayMove(replay, row * BOARD_SIZE + col);
         
         char winner = checkWinner(board);
         if (winner != EMPTY_CELL) {
@@ -758,6 +3705,7 @@ void loadSavedGame() {
         }
     }
     
+    storeReplay(replay);
     waitForEnter();
 }
 
@@ -775,10 +3723,15 @@ void mainMenu() {
         cout << "2. Загрузить сохраненную игру\n";
         cout << "3. Правила игры\n";
         cout << "4. Запустить тестирование\n";
-        cout << "5. Выйти из программы\n";
+        cout << "5. База всех партий\n";
+        cout << "6. Ultimate (9 полей 3x3)\n";
+        cout << "7. Qubic (куб 4x4x4)\n";
+        cout << "8. Решатель полей 4x4\n";
+        cout << "9. Просмотр записей партий\n";
+        cout << "10. Выйти из программы\n";
         cout << "\n";
         
-        int choice = getValidNumber("Выберите пункт меню (1-5): ", 1, 5);
+        int choice = getValidNumber("Выберите пункт меню (1-10): ", 1, 10);
         
         switch (choice) {
             case 1:
@@ -794,6 +3747,21 @@ void mainMenu() {
                 runTests();
                 break;
             case 5:
+                showGameDatabase();
+                break;
+            case 6:
+                playUltimate();
+                break;
+            case 7:
+                playQubic();
+                break;
+            case 8:
+                showRetroSolver();
+                break;
+            case 9:
+                viewReplay();
+                break;
+            case 10:
                 exitProgram = true;
                 break;
         }